@@ -14,14 +14,22 @@ from esphome.const import (
     ENTITY_CATEGORY_CONFIG,
     ENTITY_CATEGORY_DIAGNOSTIC,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
     UNIT_CELSIUS,
     UNIT_HERTZ,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
 )
 from esphome.core import coroutine
+import esphome.final_validate as fv
+
+MULTI_CONF = True  # Several indoor units can be driven from one controller, each with its own heatpump_uart
 
 AUTO_LOAD = ["climate", "select", "sensor", "binary_sensor", "text_sensor", "switch"]
 DEPENDENCIES = ["uart", "climate", "sensor", "binary_sensor", "text_sensor", "select", "switch"]
 
+DOMAIN = "mitsubishi_uart"
+
 CONF_HP_UART = "heatpump_uart"
 CONF_TS_UART = "thermostat_uart"
 
@@ -35,9 +43,37 @@ CONF_VANE_POSITION_SELECT = "vane_position_select"
 CONF_HORIZONTAL_VANE_POSITION_SELECT = "horizontal_vane_position_select"
 
 CONF_TEMPERATURE_SOURCES = "temperature_sources" # This is for specifying additional sources
+CONF_TEMPERATURE_SOURCE_FAILOVER = "temperature_source_failover"
+CONF_COMBINED_TEMPERATURE_SOURCES = "combined_temperature_sources" # Virtual sources combining several sensors
+CONF_METHOD = "method"
+CONF_MAX_AGE = "max_age"
+CONF_SOURCES = "sources"
+CONF_SOURCE = "source"
+CONF_WEIGHT = "weight"
 
 CONF_ACTIVE_MODE_SWITCH = "active_mode_switch"
 
+CONF_HEATPUMP_METRICS = "heatpump_metrics"
+CONF_THERMOSTAT_METRICS = "thermostat_metrics"
+
+CONF_MAX_REQUESTS_IN_FLIGHT = "max_requests_in_flight"
+CONF_REQUEST_RETRIES = "request_retries"
+CONF_SETTINGS_COALESCE_WINDOW = "settings_coalesce_window"
+CONF_RESPONSE_CACHE_TTL = "response_cache_ttl"
+CONF_POLL_SPACING = "poll_spacing"
+
+CONF_REMOTE_TEMPERATURE_MIN_INTERVAL = "remote_temperature_min_interval"
+CONF_REMOTE_TEMPERATURE_KEEPALIVE = "remote_temperature_keepalive"
+CONF_REMOTE_TEMPERATURE_SMOOTHING = "remote_temperature_smoothing"
+
+CONF_PUBLISH_MODE = "publish_mode"
+CONF_MIN_PUBLISH_INTERVAL = "min_publish_interval"
+CONF_FIELD_PUBLISH_THROTTLE = "field_publish_throttle"
+
+CONF_PACKET_LOG_FORMAT = "packet_log_format"
+CONF_LOOP_TIMING = "loop_timing"
+CONF_LOOP_BUDGET = "loop_budget"
+
 DEFAULT_POLLING_INTERVAL = "5s"
 
 mitsubishi_uart_ns = cg.esphome_ns.namespace("mitsubishi_uart")
@@ -49,11 +85,16 @@ HorizontalVanePositionSelect = mitsubishi_uart_ns.class_("HorizontalVanePosition
 
 ActiveModeSwitch = mitsubishi_uart_ns.class_("ActiveModeSwitch", switch.Switch, cg.Component)
 
+CombinedTemperatureSource = mitsubishi_uart_ns.class_("CombinedTemperatureSource")
+
+BridgeMetric = mitsubishi_uart_ns.enum("BridgeMetric", is_class=True)
+
 DEFAULT_CLIMATE_MODES = ["OFF", "HEAT", "DRY", "COOL", "FAN_ONLY", "HEAT_COOL"]
 DEFAULT_FAN_MODES = ["AUTO", "QUIET", "LOW", "MEDIUM", "HIGH"]
 CUSTOM_FAN_MODES = {
     "VERYHIGH": mitsubishi_uart_ns.FAN_MODE_VERYHIGH
 }
+# Must match the names and order of VANE_MAPPINGS and HORIZONTAL_VANE_MAPPINGS in muart_mappings.h
 VANE_POSITIONS = ["Auto","1","2","3","4","5","Swing"]
 HORIZONTAL_VANE_POSITIONS = ["Auto","<<","<","|",">",">>","<>","Swing"]
 
@@ -61,6 +102,43 @@ INTERNAL_TEMPERATURE_SOURCE_OPTIONS = [mitsubishi_uart_ns.TEMPERATURE_SOURCE_INT
 
 validate_custom_fan_modes = cv.enum(CUSTOM_FAN_MODES, upper=True)
 
+CombineMethod = mitsubishi_uart_ns.enum("CombineMethod", is_class=True)
+COMBINE_METHODS = {
+    "MEAN": CombineMethod.mean,
+    "MIN": CombineMethod.minimum,
+    "MAX": CombineMethod.maximum,
+    "MEDIAN": CombineMethod.median,
+}
+
+# Limits from muart_remotetemp.h and muart_combinedtemp.h (one of MAX_TEMPERATURE_SOURCES is left for Thermostat)
+MAX_CONFIGURED_TEMPERATURE_SOURCES = 7
+MAX_COMBINED_INPUTS = 8
+
+COMBINED_TEMPERATURE_SOURCE_SCHEMA = cv.Schema({
+    cv.GenerateID(CONF_ID): cv.declare_id(CombinedTemperatureSource),
+    cv.Required(CONF_NAME): cv.string,
+    cv.Optional(CONF_METHOD, default="MEAN"): cv.enum(COMBINE_METHODS, upper=True),
+    # Readings older than this are left out of the combined value
+    cv.Optional(CONF_MAX_AGE, default="5min"): cv.positive_time_period_milliseconds,
+    cv.Required(CONF_SOURCES): cv.All(cv.ensure_list(cv.Schema({
+        cv.Required(CONF_SOURCE): cv.use_id(sensor.Sensor),
+        # Must be above 0: a zero weight would leave the source out of the mean (or make it empty, if every weight is 0)
+        cv.Optional(CONF_WEIGHT, default=1.0): cv.float_range(min=0, min_included=False),
+    })), cv.Length(min=1, max=MAX_COMBINED_INPUTS)),
+})
+
+PublishMode = mitsubishi_uart_ns.enum("PublishMode", is_class=True)
+PUBLISH_MODES = {
+    "UPDATE": PublishMode.update,
+    "IMMEDIATE": PublishMode.immediate,
+}
+
+PacketLogFormat = mitsubishi_uart_ns.enum("PacketLogFormat", is_class=True)
+PACKET_LOG_FORMATS = {
+    "DETAILED": PacketLogFormat.detailed,
+    "HEX": PacketLogFormat.hex,
+}
+
 BASE_SCHEMA = cv.polling_component_schema(DEFAULT_POLLING_INTERVAL).extend(climate.CLIMATE_SCHEMA).extend({
     cv.GenerateID(CONF_ID): cv.declare_id(MitsubishiUART),
     cv.Required(CONF_HP_UART): cv.use_id(uart.UARTComponent),
@@ -71,11 +149,30 @@ BASE_SCHEMA = cv.polling_component_schema(DEFAULT_POLLING_INTERVAL).extend(clima
     cv.Optional(CONF_SUPPORTED_FAN_MODES, default=DEFAULT_FAN_MODES): cv.ensure_list(climate.validate_climate_fan_mode),
     cv.Optional(CONF_CUSTOM_FAN_MODES, default=["VERYHIGH"]) : cv.ensure_list(validate_custom_fan_modes),
     cv.Optional(CONF_TEMPERATURE_SOURCES, default=[]) : cv.ensure_list(cv.use_id(sensor.Sensor)),
+    cv.Optional(CONF_COMBINED_TEMPERATURE_SOURCES, default=[]) : cv.ensure_list(COMBINED_TEMPERATURE_SOURCE_SCHEMA),
+    cv.Optional(CONF_TEMPERATURE_SOURCE_FAILOVER, default=True) : cv.boolean,
     cv.Optional(CONF_ACTIVE_MODE_SWITCH, default={"name":"Active Mode"}) : switch.switch_schema(
         ActiveModeSwitch,
         entity_category=ENTITY_CATEGORY_CONFIG,
         default_restore_mode="RESTORE_DEFAULT_ON",
-        icon="mdi:upload-network")
+        icon="mdi:upload-network"),
+    # Pipelining requests is opt-in, since not every unit is known to answer overlapping requests reliably
+    cv.Optional(CONF_MAX_REQUESTS_IN_FLIGHT, default=1) : cv.int_range(min=1, max=4),
+    cv.Optional(CONF_REQUEST_RETRIES, default=2) : cv.int_range(min=0, max=5),
+    cv.Optional(CONF_SETTINGS_COALESCE_WINDOW, default="100ms") : cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_RESPONSE_CACHE_TTL, default="5s") : cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_POLL_SPACING, default="100ms") : cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_REMOTE_TEMPERATURE_MIN_INTERVAL, default="10s") : cv.positive_time_period_milliseconds,
+    # The heatpump reverts to its internal sensor after ~10min without a remote temperature
+    cv.Optional(CONF_REMOTE_TEMPERATURE_KEEPALIVE, default="2min") : cv.All(
+        cv.positive_time_period_milliseconds, cv.Range(max=cv.TimePeriod(minutes=5))),
+    cv.Optional(CONF_REMOTE_TEMPERATURE_SMOOTHING, default=0.0) : cv.float_range(min=0.0, max=0.95),
+    cv.Optional(CONF_PUBLISH_MODE, default="UPDATE") : cv.enum(PUBLISH_MODES, upper=True),
+    cv.Optional(CONF_MIN_PUBLISH_INTERVAL, default="250ms") : cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_FIELD_PUBLISH_THROTTLE, default="1s") : cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_PACKET_LOG_FORMAT, default="DETAILED") : cv.enum(PACKET_LOG_FORMATS, upper=True),
+    cv.Optional(CONF_LOOP_TIMING, default=False) : cv.boolean,
+    cv.Optional(CONF_LOOP_BUDGET, default="0ms") : cv.positive_time_period_microseconds,
     })
 
 # TODO Storing the registration function here seems weird, but I can't figure out how to determine schema type later
@@ -138,6 +235,43 @@ SENSORS_SCHEMA = cv.All({
     for sensor_designator, (sensor_name, sensor_schema, registration_function) in SENSORS.items()
 })
 
+def _total_metric(icon):
+    return sensor.sensor_schema(
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        accuracy_decimals=0,
+        icon=icon,
+    )
+
+def _window_metric(unit, accuracy, icon):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        accuracy_decimals=accuracy,
+        icon=icon,
+    )
+
+# Bus health metrics available for each bridge (keys match BridgeMetric values); only configured ones are created
+BRIDGE_METRICS = {
+    "frames_received": _total_metric("mdi:download-network"),
+    "frames_sent": _total_metric("mdi:upload-network"),
+    "checksum_failures": _total_metric("mdi:alert-circle-outline"),
+    "resyncs": _total_metric("mdi:sync-alert"),
+    "response_timeouts": _total_metric("mdi:timer-alert-outline"),
+    "queue_full_drops": _total_metric("mdi:tray-remove"),
+    "max_queue_depth": _window_metric(None, 0, "mdi:tray-full"),
+    "average_queue_depth": _window_metric(None, 2, "mdi:tray"),
+    "round_trip_p50": _window_metric(UNIT_MILLISECOND, 0, "mdi:timer-outline"),
+    "round_trip_p95": _window_metric(UNIT_MILLISECOND, 0, "mdi:timer-outline"),
+    "link_utilization": _window_metric(UNIT_PERCENT, 1, "mdi:gauge"),
+}
+
+BRIDGE_METRICS_SCHEMA = cv.Schema({
+    cv.Optional(metric_designator): metric_schema
+    for metric_designator, metric_schema in BRIDGE_METRICS.items()
+})
+
 SELECTS = {
     CONF_TEMPERATURE_SOURCE_SELECT: (
         "Temperature Source",
@@ -174,14 +308,52 @@ SELECTS_SCHEMA = cv.All({
 })
 
 
-CONFIG_SCHEMA = BASE_SCHEMA.extend({
+def _validate_temperature_sources(config):
+    """Readings are kept for every source, so there can't be more than the device keeps."""
+    count = len(config[CONF_TEMPERATURE_SOURCES]) + len(config[CONF_COMBINED_TEMPERATURE_SOURCES])
+    if count > MAX_CONFIGURED_TEMPERATURE_SOURCES:
+        raise cv.Invalid(f"At most {MAX_CONFIGURED_TEMPERATURE_SOURCES} {CONF_TEMPERATURE_SOURCES} and "
+                         f"{CONF_COMBINED_TEMPERATURE_SOURCES} can be configured ({count} are)")
+    return config
+
+CONFIG_SCHEMA = cv.All(BASE_SCHEMA.extend({
     cv.Optional(CONF_SENSORS, default={}): SENSORS_SCHEMA,
     cv.Optional(CONF_SELECTS, default={}): SELECTS_SCHEMA,
-})
-
+    cv.Optional(CONF_HEATPUMP_METRICS, default={}): BRIDGE_METRICS_SCHEMA,
+    cv.Optional(CONF_THERMOSTAT_METRICS, default={}): BRIDGE_METRICS_SCHEMA,
+}), _validate_temperature_sources)
+
+def _final_validate(config):
+    units = fv.full_config.get()[DOMAIN]
+    if len(units) < 2:
+        return config
+
+    if sum(1 for unit in units if unit[CONF_HP_UART] == config[CONF_HP_UART]) > 1:
+        raise cv.Invalid(f"UART {config[CONF_HP_UART]} is used as the {CONF_HP_UART} of more than one unit")
+    if sum(1 for unit in units if unit[CONF_NAME] == config[CONF_NAME]) > 1:
+        raise cv.Invalid(f"Each unit needs its own {CONF_NAME} when more than one is configured (\"{config[CONF_NAME]}\" is used twice)")
+
+    # Entities still using their default name are prefixed with the unit's name so they don't collide.  Done here,
+    # while validating, so the names are in the validated config (and `esphome config`) rather than changed later.
+    named_entities = [(config[CONF_SENSORS][designator], name) for designator, (name, _, _) in SENSORS.items()]
+    named_entities += [(config[CONF_SELECTS][designator], name) for designator, (name, _, _) in SELECTS.items()]
+    if CONF_ACTIVE_MODE_SWITCH in config:
+        named_entities.append((config[CONF_ACTIVE_MODE_SWITCH], "Active Mode"))
+    for entity_conf, default_name in named_entities:
+        if entity_conf.get(CONF_NAME) == default_name:
+            entity_conf[CONF_NAME] = f"{config[CONF_NAME]} {default_name}"
+    return config
+
+FINAL_VALIDATE_SCHEMA = _final_validate
 
 @coroutine
 async def to_code(config):
+    # Select options are extended per unit, so each unit gets its own copy
+    select_options = {
+        select_designator: list(options)
+        for select_designator, (_, _, options) in SELECTS.items()
+    }
+
     hp_uart_component = await cg.get_variable(config[CONF_HP_UART])
     muart_component = cg.new_Pvariable(config[CONF_ID], hp_uart_component)
 
@@ -194,7 +366,30 @@ async def to_code(config):
         ts_uart_component = await cg.get_variable(config[CONF_TS_UART])
         cg.add(getattr(muart_component, f"set_thermostat_uart")(ts_uart_component))
         # Add sensor as source
-        SELECTS[CONF_TEMPERATURE_SOURCE_SELECT][2].append("Thermostat")
+        select_options[CONF_TEMPERATURE_SOURCE_SELECT].append("Thermostat")
+
+    # Request scheduling
+    cg.add(muart_component.set_max_requests_in_flight(config[CONF_MAX_REQUESTS_IN_FLIGHT]))
+    cg.add(muart_component.set_request_retries(config[CONF_REQUEST_RETRIES]))
+    cg.add(muart_component.set_settings_coalesce_window(config[CONF_SETTINGS_COALESCE_WINDOW]))
+    cg.add(muart_component.set_response_cache_ttl(config[CONF_RESPONSE_CACHE_TTL]))
+    cg.add(muart_component.set_poll_spacing(config[CONF_POLL_SPACING]))
+
+    # Remote temperature
+    cg.add(muart_component.set_remote_temperature_min_interval(config[CONF_REMOTE_TEMPERATURE_MIN_INTERVAL]))
+    cg.add(muart_component.set_remote_temperature_keepalive(config[CONF_REMOTE_TEMPERATURE_KEEPALIVE]))
+    cg.add(muart_component.set_remote_temperature_smoothing(config[CONF_REMOTE_TEMPERATURE_SMOOTHING]))
+    cg.add(muart_component.set_temperature_source_failover(config[CONF_TEMPERATURE_SOURCE_FAILOVER]))
+
+    # Publishing
+    cg.add(muart_component.set_publish_mode(config[CONF_PUBLISH_MODE]))
+    cg.add(muart_component.set_min_publish_interval(config[CONF_MIN_PUBLISH_INTERVAL]))
+    cg.add(muart_component.set_field_publish_throttle(config[CONF_FIELD_PUBLISH_THROTTLE]))
+
+    # Logging
+    cg.add(muart_component.set_packet_log_format(config[CONF_PACKET_LOG_FORMAT]))
+    cg.add(muart_component.set_loop_timing(config[CONF_LOOP_TIMING]))
+    cg.add(muart_component.set_loop_budget(config[CONF_LOOP_BUDGET]))
 
     # Traits
 
@@ -223,12 +418,22 @@ async def to_code(config):
 
         cg.add(getattr(muart_component, f"set_{sensor_designator}_sensor")(sensor_component))
 
+    # Bridge metrics
+    for metrics_conf, setter in ((CONF_HEATPUMP_METRICS, "set_heatpump_metric_sensor"),
+                                 (CONF_THERMOSTAT_METRICS, "set_thermostat_metric_sensor")):
+        # Only add thermostat metrics if we have a TS_UART
+        if (metrics_conf == CONF_THERMOSTAT_METRICS) and (CONF_TS_UART not in config):
+            continue
+        for metric_designator, metric_conf in config[metrics_conf].items():
+            metric_component = await sensor.new_sensor(metric_conf)
+            cg.add(getattr(muart_component, setter)(getattr(BridgeMetric, metric_designator), metric_component))
+
     ### Selects
 
     # Add additional configured temperature sensors to the select menu
     for ts_id in config[CONF_TEMPERATURE_SOURCES]:
         ts = await cg.get_variable(ts_id)
-        SELECTS[CONF_TEMPERATURE_SOURCE_SELECT][2].append(ts.get_name())
+        select_options[CONF_TEMPERATURE_SOURCE_SELECT].append(ts.get_name())
         cg.add(getattr(ts, "add_on_state_callback")(
             # TODO: Is there anyway to do this without a raw expression?
             cg.RawExpression(
@@ -236,11 +441,21 @@ async def to_code(config):
             )
         ))
 
+    # Add combined sources, which report to the MUART themselves
+    for combined_conf in config[CONF_COMBINED_TEMPERATURE_SOURCES]:
+        combined = cg.new_Pvariable(combined_conf[CONF_ID], combined_conf[CONF_NAME], combined_conf[CONF_METHOD],
+                                    combined_conf[CONF_MAX_AGE])
+        await cg.register_parented(combined, muart_component)
+        for source_conf in combined_conf[CONF_SOURCES]:
+            source = await cg.get_variable(source_conf[CONF_SOURCE])
+            cg.add(combined.add_input(source, source_conf[CONF_WEIGHT]))
+        select_options[CONF_TEMPERATURE_SOURCE_SELECT].append(combined_conf[CONF_NAME])
+
     # Register selects
-    for select_designator, (select_name, select_schema, select_options) in SELECTS.items():
+    for select_designator, (select_name, select_schema, _) in SELECTS.items():
         select_conf = config[CONF_SELECTS][select_designator]
         select_component = cg.new_Pvariable(select_conf[CONF_ID])
-        await select.register_select(select_component, select_conf, options=select_options)
+        await select.register_select(select_component, select_conf, options=select_options[select_designator])
         cg.add(getattr(muart_component, f"set_{select_designator}")(select_component))
         await cg.register_parented(select_component, muart_component)
 
@@ -8,41 +8,26 @@ void MitsubishiUART::control(const climate::ClimateCall &call) {
 
   if (!active_mode) return; // If we're not in active mode, ignore control requests
 
-  SettingsSetRequestPacket setRequestPacket = SettingsSetRequestPacket();
+  OwnedPacket<SettingsSetRequestPacket> setRequestPacket = SettingsSetRequestPacket::create();
 
   // Fan
 
   if (call.get_custom_fan_mode().has_value()) {
-    if (call.get_custom_fan_mode().value() == FAN_MODE_VERYHIGH) {
-      set_custom_fan_mode_(FAN_MODE_VERYHIGH);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_4);
+    if (const CustomFanMapping *fan = mappingForValue(CUSTOM_FAN_MAPPINGS, call.get_custom_fan_mode().value())) {
+      set_custom_fan_mode_(fan->value);
+      setRequestPacket.setFan(fan->byte);
+    } else {
+      ESP_LOGW(TAG, "Unhandled custom fan mode %s!", call.get_custom_fan_mode().value().c_str());
     }
   }
 
-  switch(call.get_fan_mode().value()) {
-    case climate::CLIMATE_FAN_QUIET:
-      set_fan_mode_(climate::CLIMATE_FAN_QUIET);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_QUIET);
-      break;
-    case climate::CLIMATE_FAN_LOW:
-      set_fan_mode_(climate::CLIMATE_FAN_LOW);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_1);
-      break;
-    case climate::CLIMATE_FAN_MEDIUM:
-      set_fan_mode_(climate::CLIMATE_FAN_MEDIUM);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_2);
-      break;
-    case climate::CLIMATE_FAN_HIGH:
-      set_fan_mode_(climate::CLIMATE_FAN_HIGH);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_3);
-      break;
-    case climate::CLIMATE_FAN_AUTO:
-      set_fan_mode_(climate::CLIMATE_FAN_AUTO);
-      setRequestPacket.setFan(SettingsSetRequestPacket::FAN_AUTO);
-      break;
-    default:
+  if (call.get_fan_mode().has_value()) {
+    if (const FanMapping *fan = mappingForValue(FAN_MAPPINGS, call.get_fan_mode().value())) {
+      set_fan_mode_(fan->value);
+      setRequestPacket.setFan(fan->byte);
+    } else {
       ESP_LOGW(TAG, "Unhandled fan mode %i!", call.get_fan_mode().value());
-      break;
+    }
   }
 
   // Mode
@@ -50,26 +35,11 @@ void MitsubishiUART::control(const climate::ClimateCall &call) {
   if (call.get_mode().has_value()){
     mode = call.get_mode().value();
 
-    switch(call.get_mode().value()) {
-      case climate::CLIMATE_MODE_HEAT_COOL:
-        setRequestPacket.setPower(true).setMode(SettingsSetRequestPacket::MODE_BYTE_AUTO);
-        break;
-      case climate::CLIMATE_MODE_COOL:
-        setRequestPacket.setPower(true).setMode(SettingsSetRequestPacket::MODE_BYTE_COOL);
-        break;
-      case climate::CLIMATE_MODE_HEAT:
-        setRequestPacket.setPower(true).setMode(SettingsSetRequestPacket::MODE_BYTE_HEAT);
-        break;
-      case climate::CLIMATE_MODE_FAN_ONLY:
-        setRequestPacket.setPower(true).setMode(SettingsSetRequestPacket::MODE_BYTE_FAN);
-        break;
-      case climate::CLIMATE_MODE_DRY:
-        setRequestPacket.setPower(true).setMode(SettingsSetRequestPacket::MODE_BYTE_DRY);
-        break;
-      case climate::CLIMATE_MODE_OFF:
-      default:
-        setRequestPacket.setPower(false);
-        break;
+    if (const ModeMapping *modeMapping = mappingForValue(MODE_MAPPINGS, mode)) {
+      setRequestPacket.setPower(true).setMode(modeMapping->byte);
+    } else {
+      // CLIMATE_MODE_OFF, or anything we can't set
+      setRequestPacket.setPower(false);
     }
   }
 
@@ -87,10 +57,10 @@ void MitsubishiUART::control(const climate::ClimateCall &call) {
 
   // We're assuming that every climate call *does* make some change worth sending to the heat pump
   // Queue the packet to be sent first (so any subsequent update packets come *after* our changes)
-  hp_bridge.sendPacket(setRequestPacket);
+  sendSettings(setRequestPacket);
 
-  // Publish state and any sensor changes (shouldn't be any a a result of this function, but
-  // since they lazy-publish, no harm in trying)
+  // Publish the new state (along with any sensor changes already waiting, since they lazy-publish)
+  markDirty(DIRTY_CLIMATE);
   doPublish();
 };
 
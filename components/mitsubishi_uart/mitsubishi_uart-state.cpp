@@ -0,0 +1,246 @@
+#include "mitsubishi_uart.h"
+#include <cinttypes>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+/* Called by packet handlers after updating a group of workingState fields.  Changes are committed straight away
+when none of our requests are outstanding (e.g. unsolicited packets, or a capture being replayed), otherwise
+they wait for commitStateIfSettled.*/
+void MitsubishiUART::reportState(const uint8_t group, const bool changed) {
+  // The first report for a group always counts as a change, since nothing has been derived from it yet.  Neither
+  // does a stale group's, so entities set optimistically are put back to what the heatpump reports.
+  if (!changed && (workingState.received & group) && !(staleGroups & group)) return;
+
+  workingState.received |= group;
+  staleGroups &= ~group;
+  if (workingChanges == 0) workingChangedMillis = millis();
+  workingChanges |= group;
+
+  if (hp_bridge.requestsSettled()) commitState();
+}
+
+/* Commits the working state once all of our outstanding requests have been answered, so every response from a poll
+cycle is committed together.  If requests keep the bus busy for too long, changes are committed anyway.*/
+void MitsubishiUART::commitStateIfSettled() {
+  if (workingChanges == 0) return;
+  if (!hp_bridge.requestsSettled() && millis() - workingChangedMillis < MAX_STATE_COMMIT_WAIT_MS) return;
+  commitState();
+}
+
+void MitsubishiUART::commitState() {
+  const uint8_t changes = workingChanges;
+  workingChanges = 0;
+
+  workingState.generation++;
+  committedState = workingState;
+  ESP_LOGV(TAG, "Committed heatpump state generation %" PRIu32 " (changed groups %02x)", committedState.generation, changes);
+
+  if (stateProvisional && (changes & STATE_SETTINGS)) {
+    stateProvisional = false;
+    ESP_LOGI(TAG, "Restored state replaced by the heat pump's.");
+  }
+  if (changes & STATE_PERSISTED) stateSavePending = true;
+
+  deriveEntities(changes);
+}
+
+// Saves the persisted groups of the committed state, at most once per STATE_SAVE_INTERVAL_MS
+void MitsubishiUART::save_state_if_due() {
+  if (!stateSavePending || millis() - lastStateSaveMillis < STATE_SAVE_INTERVAL_MS) return;
+  stateSavePending = false;
+  lastStateSaveMillis = millis();
+
+  const HeatpumpState &state = committedState;
+  MUARTLastState saved;
+  saved.version = STATE_PREFERENCE_VERSION;
+  saved.received = state.received & STATE_PERSISTED;
+  saved.power = state.power;
+  saved.mode = state.mode;
+  saved.fan = state.fan;
+  saved.vane = state.vane;
+  saved.horizontalVane = state.horizontalVane;
+  saved.targetTemperature = state.targetTemperature;
+  saved.currentTemperature = state.currentTemperature;
+  state_preferences_.save(&saved);
+  ESP_LOGV(TAG, "Saved heatpump state generation %" PRIu32, state.generation);
+}
+
+/* Restores the state saved before the last reboot and publishes entities from it straight away.  It's provisional:
+the restored values are committed as generation 0, but the working state starts with nothing received, so every
+group's first response is committed (replacing the restored values) even if it's unchanged.*/
+void MitsubishiUART::restore_state() {
+  MUARTLastState saved;
+  if (!state_preferences_.load(&saved) || saved.version != STATE_PREFERENCE_VERSION
+      || (saved.received & STATE_PERSISTED) == 0) {
+    ESP_LOGCONFIG(TAG, "No saved state, entities will be unavailable until the heat pump reports.");
+    return;
+  }
+
+  HeatpumpState state;
+  state.received = saved.received & STATE_PERSISTED;
+  state.power = saved.power;
+  state.mode = saved.mode;
+  state.fan = saved.fan;
+  state.vane = saved.vane;
+  state.horizontalVane = saved.horizontalVane;
+  state.targetTemperature = saved.targetTemperature;
+  state.currentTemperature = saved.currentTemperature;
+
+  committedState = state;
+  workingState = state;
+  workingState.received = 0;
+  stateProvisional = true;
+
+  ESP_LOGCONFIG(TAG, "Restored saved state (provisional until the heat pump reports).");
+  deriveEntities(committedState.received);
+  doPublish();
+}
+
+/* Updates entities from the committed state, marking any that changed to be published.  Only entities derived from
+groups that changed are touched, so values set optimistically by a climate call aren't reverted by unrelated responses.*/
+void MitsubishiUART::deriveEntities(const uint8_t groups) {
+  const HeatpumpState &state = committedState;
+
+  if (groups & STATE_SETTINGS) {
+    const climate::ClimateMode old_mode = mode;
+    mode = deriveMode(state);
+    markDirty(DIRTY_CLIMATE, old_mode != mode);
+
+    const float old_target_temperature = target_temperature;
+    target_temperature = state.targetTemperature;
+    markDirty(DIRTY_CLIMATE, old_target_temperature != target_temperature);
+
+    bool fanChanged = false;
+    if (const FanMapping *fan = mappingForByte(FAN_MAPPINGS, state.fan)) {
+      fanChanged = set_fan_mode_(fan->value);
+    } else if (const CustomFanMapping *customFan = mappingForByte(CUSTOM_FAN_MAPPINGS, state.fan)) {
+      fanChanged = set_custom_fan_mode_(customFan->value);
+    }
+    markDirty(DIRTY_CLIMATE, fanChanged);
+
+    if (const VaneMapping *vane = mappingForByte(VANE_MAPPINGS, state.vane)) {
+      markDirty(DIRTY_VANE_POSITION, vane_position_select->state != vane->value);
+      vane_position_select->state = vane->value;
+    } else {
+      ESP_LOGW(TAG, "Vane in unknown position %x", state.vane);
+    }
+
+    if (const HorizontalVaneMapping *vane = mappingForByte(HORIZONTAL_VANE_MAPPINGS, state.horizontalVane)) {
+      markDirty(DIRTY_HORIZONTAL_VANE_POSITION, horizontal_vane_position_select->state != vane->value);
+      horizontal_vane_position_select->state = vane->value;
+    } else {
+      ESP_LOGW(TAG, "Vane in unknown horizontal position %x", state.horizontalVane);
+    }
+  }
+
+  if (groups & STATE_CURRENT_TEMP) {
+    const float old_current_temperature = current_temperature;
+    current_temperature = state.currentTemperature;
+    markDirty(DIRTY_CLIMATE, old_current_temperature != current_temperature);
+  }
+
+  // Action depends on the mode and temperatures as well as the status, but they all come from the same snapshot
+  if ((groups & (STATE_SETTINGS | STATE_STATUS | STATE_CURRENT_TEMP)) && (state.received & STATE_STATUS)) {
+    const climate::ClimateAction old_action = action;
+    action = deriveAction(state, action);
+    markDirty(DIRTY_CLIMATE, old_action != action);
+  }
+
+  if ((groups & STATE_STATUS) && compressor_frequency_sensor) {
+    const float old_compressor_frequency = compressor_frequency_sensor->raw_state;
+    compressor_frequency_sensor->raw_state = state.compressorFrequency;
+    markDirty(DIRTY_COMPRESSOR_FREQUENCY, old_compressor_frequency != compressor_frequency_sensor->raw_state);
+  }
+
+  if (groups & STATE_STANDBY) {
+    if (service_filter_sensor) {
+      markDirty(DIRTY_SERVICE_FILTER, service_filter_sensor->state != state.serviceFilter);
+      service_filter_sensor->state = state.serviceFilter;
+    }
+    if (defrost_sensor) {
+      markDirty(DIRTY_DEFROST, defrost_sensor->state != state.defrost);
+      defrost_sensor->state = state.defrost;
+    }
+    if (hot_adjust_sensor) {
+      markDirty(DIRTY_HOT_ADJUST, hot_adjust_sensor->state != state.hotAdjust);
+      hot_adjust_sensor->state = state.hotAdjust;
+    }
+    if (standby_sensor) {
+      markDirty(DIRTY_STANDBY, standby_sensor->state != state.standby);
+      standby_sensor->state = state.standby;
+    }
+    if (actual_fan_sensor && state.actualFanSpeed < ACTUAL_FAN_SPEED_NAMES.size()) {
+      const std::string &actual_fan = ACTUAL_FAN_SPEED_NAMES[state.actualFanSpeed];
+      markDirty(DIRTY_ACTUAL_FAN, actual_fan_sensor->raw_state != actual_fan);
+      actual_fan_sensor->raw_state = actual_fan;
+    }
+  }
+
+  if ((groups & STATE_ERROR) && error_code_sensor) {
+    // TODO: Include friendly text from JSON, somehow.
+    std::string errorCode;
+    if (!state.errorPresent) {
+      errorCode = "No Error Reported";
+    } else if (state.errorShortCode != 0x00) {
+      char shortCode[8];
+      ErrorStateGetResponsePacket::formatShortCode(state.errorShortCode, shortCode);
+      errorCode = std::string("Error ") + shortCode;
+    } else {
+      errorCode = "Error " + to_string(state.errorCode);
+    }
+    markDirty(DIRTY_ERROR_CODE, error_code_sensor->raw_state != errorCode);
+    error_code_sensor->raw_state = errorCode;
+  }
+
+  if ((groups & STATE_THERMOSTAT) && thermostat_temperature_sensor) {
+    const float old_thermostat_temp = thermostat_temperature_sensor->raw_state;
+    thermostat_temperature_sensor->raw_state = state.thermostatTemperature;
+    markDirty(DIRTY_THERMOSTAT_TEMPERATURE, old_thermostat_temp != thermostat_temperature_sensor->raw_state);
+  }
+}
+
+climate::ClimateMode MitsubishiUART::deriveMode(const HeatpumpState &state) {
+  if (!state.power) return climate::CLIMATE_MODE_OFF;
+
+  const ModeMapping *modeMapping = mappingForByte(MODE_MAPPINGS, state.mode);
+  return modeMapping ? modeMapping->value : climate::CLIMATE_MODE_OFF;
+}
+
+// `previous_action` is kept when the state doesn't determine a new one
+climate::ClimateAction MitsubishiUART::deriveAction(const HeatpumpState &state,
+                                                    const climate::ClimateAction previous_action) {
+  const climate::ClimateMode mode = deriveMode(state);
+
+  // If mode is off, action is off
+  if (mode == climate::CLIMATE_MODE_OFF) return climate::CLIMATE_ACTION_OFF;
+  // If mode is fan only, the unit may not report operating, but the fan is running
+  if (mode == climate::CLIMATE_MODE_FAN_ONLY) return climate::CLIMATE_ACTION_FAN;
+  // If we're not operating (but not off or in fan mode), we're idle
+  if (!state.operating) return climate::CLIMATE_ACTION_IDLE;
+
+  // If mode is anything other than off or fan, and the unit is operating, determine the action
+  switch (mode) {
+    case climate::CLIMATE_MODE_HEAT:
+      return climate::CLIMATE_ACTION_HEATING;
+    case climate::CLIMATE_MODE_COOL:
+      return climate::CLIMATE_ACTION_COOLING;
+    case climate::CLIMATE_MODE_DRY:
+      return climate::CLIMATE_ACTION_DRYING;
+    // TODO: This only works if we get an update while the temps are in this configuration
+    // Surely there's some info from the heat pump about which of these modes it's in?
+    case climate::CLIMATE_MODE_HEAT_COOL:
+      if (state.currentTemperature > state.targetTemperature) return climate::CLIMATE_ACTION_COOLING;
+      if (state.currentTemperature < state.targetTemperature) return climate::CLIMATE_ACTION_HEATING;
+      // When the heat pump *changes* to a new action, these temperature comparisons should be accurate.
+      // If the mode hasn't changed, but the temps are equal, we can assume the same action and make no change.
+      // If the unit overshoots, this still doesn't work.
+      return previous_action;
+    default:
+      ESP_LOGW(TAG, "Unhandled mode %i.", mode);
+      return previous_action;
+  }
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
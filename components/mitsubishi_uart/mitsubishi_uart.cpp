@@ -1,4 +1,5 @@
 #include "mitsubishi_uart.h"
+#include <cinttypes>
 
 namespace esphome {
 namespace mitsubishi_uart {
@@ -8,6 +9,9 @@ namespace mitsubishi_uart {
 ////
 
 MitsubishiUART::MitsubishiUART(uart::UARTComponent *hp_uart_comp) : hp_uart{*hp_uart_comp}, hp_bridge{HeatpumpBridge(hp_uart_comp, this)} {
+  hp_bridge.set_loop_monitor(&loopMonitor);
+  pollUnit = PollCoordinator::instance().registerUnit();
+  for (PollSchedule &poll : pollSchedules) poll.parent = this;
 
   /**
    * Climate pushes all its data to Home Assistant immediately when the API connects, this causes
@@ -22,6 +26,7 @@ MitsubishiUART::MitsubishiUART(uart::UARTComponent *hp_uart_comp) : hp_uart{*hp_
 // Used to restore state of previous MUART-specific settings (like temperature source or pass-thru mode)
 // Most other climate-state is preserved by the heatpump itself and will be retrieved after connection
 void MitsubishiUART::setup() {
+  configured_traits_ = climate_traits_;
 
   // Populate select map
   for (size_t index=0;index<temperature_source_select->traits.get_options().size();index++){
@@ -32,6 +37,16 @@ void MitsubishiUART::setup() {
   // is an easy way to prevent wierd conflicts if e.g. select options change.
   preferences_ = global_preferences->make_preference<MUARTPreferences>(get_object_id_hash() ^ fnv1_hash(App.get_compilation_time()));
   restore_preferences();
+
+  // Capabilities from the last boot are applied right away; fresh ones are requested as soon as we connect
+  capabilities_preferences_ = global_preferences->make_preference<MUARTCapabilities>(get_object_id_hash() ^ CAPABILITIES_PREFERENCE_KEY);
+  restore_capabilities();
+
+  // The last known state is shown straight away (as provisional) so entities aren't unavailable until we've polled
+  state_preferences_ = global_preferences->make_preference<MUARTLastState>(get_object_id_hash() ^ STATE_PREFERENCE_KEY);
+  restore_state();
+
+  sendIfActive(ConnectRequestPacket::instance());
 }
 
 void MitsubishiUART::save_preferences() {
@@ -70,6 +85,83 @@ void MitsubishiUART::restore_preferences() {
       currentTemperatureSource = TEMPERATURE_SOURCE_INTERNAL;
       temperature_source_select->publish_state(TEMPERATURE_SOURCE_INTERNAL);
     }
+  activeTemperatureSource = currentTemperatureSource;
+}
+
+void MitsubishiUART::save_capabilities(const ExtendedConnectResponsePacket &capabilities) {
+  const RawPacket &raw = capabilities.rawPacket();
+
+  // Capabilities rarely change, so skip the flash write if they're the same as what's stored
+  MUARTCapabilities stored;
+  if (capabilities_preferences_.load(&stored) && stored.length == raw.getLength()
+      && memcmp(stored.frame, raw.getBytes(), stored.length) == 0) {
+    return;
+  }
+
+  MUARTCapabilities prefs;
+  prefs.length = raw.getLength();
+  memcpy(prefs.frame, raw.getBytes(), prefs.length);
+  capabilities_preferences_.save(&prefs);
+  ESP_LOGI(TAG, "Capabilities saved.");
+}
+
+// Applies the capabilities received on a previous boot, so traits are right before we've even connected
+void MitsubishiUART::restore_capabilities() {
+  MUARTCapabilities prefs;
+  if (!capabilities_preferences_.load(&prefs) || prefs.length == 0 || prefs.length > PACKET_MAX_SIZE) {
+    ESP_LOGCONFIG(TAG, "No saved capabilities, using configured traits until connected.");
+    return;
+  }
+
+  RawPacket frame(prefs.frame, prefs.length);
+  const ExtendedConnectResponsePacket capabilities(&frame);
+  if (!capabilities.isChecksumValid()
+      || capabilities.getPacketType() != static_cast<uint8_t>(PacketType::extended_connect_response)) {
+    ESP_LOGW(TAG, "Saved capabilities were invalid, ignoring them.");
+    return;
+  }
+
+  ESP_LOGCONFIG(TAG, "Capabilities loaded.");
+  applyCapabilities(capabilities);
+}
+
+/* Limits the configured traits to what the heat pump says it supports, and takes its setpoint range.  The heat pump
+doesn't report whether it supports HEAT_COOL, so that's left as configured.  Swing modes aren't advertised since
+control() can't set them yet.*/
+void MitsubishiUART::applyCapabilities(const ExtendedConnectResponsePacket &capabilities) {
+  _capabilitiesCache = OwnedPacket<ExtendedConnectResponsePacket>(capabilities);
+  const climate::ClimateTraits reported = capabilities.asTraits();
+  climate::ClimateTraits traits = configured_traits_;
+
+  std::set<climate::ClimateMode> modes;
+  for (const climate::ClimateMode supported_mode : configured_traits_.get_supported_modes()) {
+    if (supported_mode == climate::CLIMATE_MODE_HEAT_COOL || reported.supports_mode(supported_mode)) {
+      modes.insert(supported_mode);
+    }
+  }
+  traits.set_supported_modes(modes);
+
+  std::set<climate::ClimateFanMode> fanModes;
+  for (const climate::ClimateFanMode supported_fan_mode : configured_traits_.get_supported_fan_modes()) {
+    if (reported.supports_fan_mode(supported_fan_mode)) fanModes.insert(supported_fan_mode);
+  }
+  traits.set_supported_fan_modes(fanModes);
+
+  std::set<std::string> customFanModes;
+  for (const std::string &supported_fan_mode : configured_traits_.get_supported_custom_fan_modes()) {
+    if (reported.supports_custom_fan_mode(supported_fan_mode)) customFanModes.insert(supported_fan_mode);
+  }
+  traits.set_supported_custom_fan_modes(customFanModes);
+
+  if (reported.get_visual_min_temperature() < reported.get_visual_max_temperature()) {
+    traits.set_visual_min_temperature(reported.get_visual_min_temperature());
+    traits.set_visual_max_temperature(reported.get_visual_max_temperature());
+  }
+
+  climate_traits_ = traits;
+  ESP_LOGI(TAG, "Applied capabilities: %u modes, %u fan modes, setpoints %.1f to %.1f", (unsigned) modes.size(),
+           (unsigned) (fanModes.size() + customFanModes.size()), traits.get_visual_min_temperature(),
+           traits.get_visual_max_temperature());
 }
 
 void MitsubishiUART::sendIfActive(const Packet& packet) {
@@ -84,20 +176,81 @@ void MitsubishiUART::sendIfActive(const Packet& packet) {
   should not block for very long (e.g. no publishing inside the packet processing)
 */
 void MitsubishiUART::loop() {
-  // Loop bridge to handle sending and receiving packets
-  hp_bridge.loop();
-  if (ts_bridge) ts_bridge->loop();
-
-  // If it's been too long since we received a temperature update (and we're not set to Internal)
-  if (((millis() - lastReceivedTemperature) > TEMPERATURE_SOURCE_TIMEOUT_MS) && (temperature_source_select->state != TEMPERATURE_SOURCE_INTERNAL)) {
-    ESP_LOGW(TAG, "No temperature received from %s for %i milliseconds, reverting to Internal source", currentTemperatureSource.c_str(), TEMPERATURE_SOURCE_TIMEOUT_MS);
-    // Set the select to show Internal (but do not change currentTemperatureSource)
-    temperature_source_select->publish_state(TEMPERATURE_SOURCE_INTERNAL);
-    // Send a packet to the heat pump to tell it to switch to internal temperature sensing
-    IFACTIVE(hp_bridge.sendPacket(RemoteTemperatureSetRequestPacket().useInternalTemperature());)
-  }
-  //
-  // Send packet to HP to tell it to use internal temp sensor
+  loopMonitor.startLoop();
+  LoopMonitor::Scope loopTiming(&loopMonitor, LoopStage::loop);
+
+  /* Receive everything from both sides before sending anything, so a request the thermostat just made
+  is queued for the heatpump this iteration and can go ahead of our own traffic.  If the loop budget
+  runs out, the next iteration resumes with the work that was skipped (rather than starting over), so
+  work late in the order can't be starved by work early in it.*/
+  uint8_t work = loopResumeWork;
+  loopResumeWork = 0;
+  for (bool first = true; work < LOOP_WORK_COUNT; work++) {
+    if (!ts_bridge && (work == static_cast<uint8_t>(LoopWork::thermostat_receive) ||
+                       work == static_cast<uint8_t>(LoopWork::thermostat_send))) {
+      continue;
+    }
+    if (!first && yieldForBudget()) {
+      loopResumeWork = work;
+      break;
+    }
+    runLoopWork(static_cast<LoopWork>(work));
+    first = false;
+  }
+
+  // Cheap housekeeping, run every iteration whatever the budget
+  commitStateIfSettled();
+  publishImmediateChanges();
+  save_state_if_due();
+
+  checkTemperatureSourceTimeout();
+}
+
+void MitsubishiUART::runLoopWork(const LoopWork work) {
+  switch (work) {
+    case LoopWork::heatpump_receive: {
+      LoopMonitor::Scope timing(&loopMonitor, LoopStage::heatpump_receive);
+      hp_bridge.receivePackets();
+      break;
+    }
+    case LoopWork::thermostat_receive: {
+      LoopMonitor::Scope timing(&loopMonitor, LoopStage::thermostat_receive);
+      ts_bridge->receivePackets();
+      break;
+    }
+    case LoopWork::heatpump_send: {
+      LoopMonitor::Scope timing(&loopMonitor, LoopStage::heatpump_send);
+      hp_bridge.sendPackets();
+      break;
+    }
+    case LoopWork::thermostat_send: {
+      LoopMonitor::Scope timing(&loopMonitor, LoopStage::thermostat_send);
+      ts_bridge->sendPackets();
+      break;
+    }
+    case LoopWork::requests:
+      // Request any updates that are due from the heatpump
+      runPollSchedule();
+      // Send any remote temperature change that was held back, or a keep-alive
+      sendRemoteTemperatureIfDue();
+      break;
+  }
+}
+
+// Returns true (and counts a yield) if this loop has used up its time budget
+bool MitsubishiUART::yieldForBudget() {
+  if (!loopMonitor.budgetExhausted()) return false;
+  loopMonitor.noteYield();
+  return true;
+}
+
+void MitsubishiUART::dump_packet_capture() const {
+  ESP_LOGI(TAG, "Heatpump bridge capture:");
+  hp_bridge.capture().dump();
+  if (ts_bridge) {
+    ESP_LOGI(TAG, "Thermostat bridge capture:");
+    ts_bridge->capture().dump();
+  }
 }
 
 void MitsubishiUART::dump_config() {
@@ -106,193 +259,304 @@ void MitsubishiUART::dump_config() {
   }
 }
 
-/* Called periodically as PollingComponent; used to send packets to connect or request updates.
+/* Called periodically as PollingComponent; used to send packets to connect, and to publish changes.
+Requests for updates are sent from loop() according to pollSchedules.
 
-Possible TODO: If we only publish during updates, since data is received during loop, updates will always
-be about `update_interval` late from their actual time.  Generally the update interval should be low enough
-(default is 5seconds) this won't pose a practical problem.
+Since data is received during loop, changes published here are on average half an `update_interval` late
+from their actual time.  Where that matters (e.g. automations reacting to defrost), PublishMode::immediate
+publishes them from loop() instead.
 */
 void MitsubishiUART::update() {
-  // TODO: Temporarily wait 5 seconds on startup to help with viewing logs
-  if (millis() < 5000) {
-    return;
+  // Bus metrics are most interesting when something's wrong, so they're published even if we're not connected
+  if (millis() - lastMetricsPublish >= METRICS_PUBLISH_INTERVAL_MS) {
+    publishMetrics();
+    loopMonitor.report();
+    lastMetricsPublish = millis();
   }
 
-  // If we're not yet connected, send off a connection request (we'll check again next update)
+  // If we're not yet connected, send off a connection request (we'll check again next update).  setup() has
+  // already sent one, so wait until it's been answered or has timed out before asking again.
   if (!hpConnected) {
-    IFACTIVE(hp_bridge.sendPacket(ConnectRequestPacket::instance());)
+    if (hp_bridge.requestsSettled()) {
+      IFACTIVE(hp_bridge.sendPacket(ConnectRequestPacket::instance());)
+    }
     return;
   }
 
-  // Attempt to read capabilities on the next loop after connect.
-  // TODO: This should likely be done immediately after connect, and will likely need to block setup for proper autoconf.
-  //       For now, just requesting it as part of our "init loops" is a good first step.
-  if (!this->_capabilitiesRequested) {
-    IFACTIVE(
-    hp_bridge.sendPacket(ExtendedConnectRequestPacket::instance());
-    this->_capabilitiesRequested = true;
-    )
+  // Publish any changes waiting from packets received
+  if (publishMode == PublishMode::update && dirtyFields != 0){
+    doPublish();
   }
+}
 
-  // Before requesting additional updates, publish any changes waiting from packets received
-  if (publishOnUpdate){
-    doPublish();
+/* Sends at most one due poll per call, picking the highest priority (lowest value) when several are due.
+Polls aren't sent until we're connected, or while a previous request for the same command is still waiting.
+When several units are configured, each poll also waits its turn with the PollCoordinator.*/
+void MitsubishiUART::runPollSchedule() {
+  if (!hpConnected || !active_mode) return;
 
-    publishOnUpdate = false;
+  const uint32_t now = millis();
+  PollSchedule *next = nullptr;
+
+  for (PollSchedule &poll : pollSchedules) {
+    if (poll.inFlight) continue;
+    if (poll.polled && (now - poll.lastPollMillis < poll.intervalMs)) continue;
+    if (next == nullptr || poll.priority < next->priority) next = &poll;
   }
 
-  IFACTIVE(
-  // Request an update from the heatpump
-  // TODO: This isn't a problem *yet*, but sending all these packets every loop might start to cause some issues in
-  //       certain configurations or setups. We may want to consider only asking for certain packets on a rarer cadence,
-  //       depending on their utility (e.g. we dont need to check for errors every loop).
-  hp_bridge.sendPacket(GetRequestPacket::getSettingsInstance()); // Needs to be done before status packet for mode logic to work
-  hp_bridge.sendPacket(GetRequestPacket::getStandbyInstance());
-  hp_bridge.sendPacket(GetRequestPacket::getStatusInstance());
-  hp_bridge.sendPacket(GetRequestPacket::getCurrentTempInstance());
-  hp_bridge.sendPacket(GetRequestPacket::getErrorInfoInstance());
-  )
+  if (next == nullptr) return;
+
+  // If the thermostat's own request just fetched this value, it's already been processed; no need to ask again
+  const CachedResponse *cached = responseCache.fresh(static_cast<uint8_t>(next->command));
+  if (cached && cached->controllerAssociation == ControllerAssociation::thermostat) {
+    next->polled = true;
+    next->lastPollMillis = now;
+    const RawPacket response = cached->rawPacket();
+    pollCompleted(*next, &response);
+    return;
+  }
+
+  if (!PollCoordinator::instance().claimSlot(pollUnit)) return;
+
+  next->polled = true;
+  next->lastPollMillis = now;
+  next->inFlight = true;
+  hp_bridge.sendPacket(GetRequestPacket::forCommand(next->command),
+                       ResponseCallback([](void *context, const RawPacket *response) {
+                         PollSchedule &poll = *static_cast<PollSchedule *>(context);
+                         poll.parent->pollCompleted(poll, response);
+                       }, next));
 }
 
-void MitsubishiUART::doPublish() {
-  publish_state();
-  vane_position_select->publish_state(vane_position_select->state);
-  horizontal_vane_position_select->publish_state(horizontal_vane_position_select->state);
-  save_preferences(); // We can save this every time we publish as writes to flash are by default collected and delayed
-
-  // Check sensors and publish if needed.
-  // This is a bit of a hack to avoid needing to publish sensor data immediately as packets arrive.
-  // Instead, packet data is written directly to `raw_state` (which doesn't update `state`).  If they
-  // differ, calling `publish_state` will update `state` so that it won't be published later
-  if (thermostat_temperature_sensor && (thermostat_temperature_sensor->raw_state != thermostat_temperature_sensor->state)) {
+// Adjusts the poll's interval depending on whether the response changed since last time
+void MitsubishiUART::pollCompleted(PollSchedule &poll, const RawPacket *response) {
+  poll.inFlight = false;
+
+  // On timeout, just try again at the current interval
+  if (response == nullptr) return;
+
+  const bool changed = !poll.hasResponse || memcmp(poll.lastResponse, response->getBytes(), response->getLength()) != 0;
+  memcpy(poll.lastResponse, response->getBytes(), response->getLength());
+  poll.hasResponse = true;
+
+  if (changed || (int32_t) (pollBoostUntil - millis()) > 0) {
+    poll.intervalMs = poll.minIntervalMs;
+  } else {
+    poll.intervalMs = std::min(poll.intervalMs * 2, poll.maxIntervalMs);
+  }
+}
+
+// Polls everything at its fastest rate for a while, so the results of a change show up quickly
+void MitsubishiUART::boostPolling() {
+  pollBoostUntil = millis() + POLL_BOOST_DURATION_MS;
+  for (PollSchedule &poll : pollSchedules) {
+    poll.intervalMs = poll.minIntervalMs;
+  }
+}
+
+/* Entities are updated optimistically when a change is requested, but an unchanged settings response isn't
+committed, so if the change is refused (or never answered) they'd keep showing it.  Once the set request completes,
+settings are marked stale so the next settings response is committed and re-derived regardless.*/
+void MitsubishiUART::sendSettings(const SettingsSetRequestPacket &packet) {
+  hp_bridge.sendPacket(packet, ResponseCallback([](void *context, const RawPacket *response) {
+                         static_cast<MitsubishiUART *>(context)->staleGroups |= STATE_SETTINGS;
+                       }, this));
+  boostPolling();
+}
+
+void MitsubishiUART::publishMetrics() {
+  publishBridgeMetrics(hp_bridge, hp_metric_sensors);
+  if (ts_bridge) publishBridgeMetrics(*ts_bridge, ts_metric_sensors);
+}
+
+void MitsubishiUART::publishBridgeMetrics(MUARTBridge &bridge,
+                                          const std::array<sensor::Sensor *, BRIDGE_METRIC_COUNT> &sensors) {
+  for (uint8_t i = 0; i < BRIDGE_METRIC_COUNT; i++) {
+    if (sensors[i]) sensors[i]->publish_state(bridge.metric(static_cast<BridgeMetric>(i)));
+  }
+  bridge.resetMetricsWindow();
+}
+
+/* In immediate mode, publishes changes as soon as they're committed (so e.g. a mode change isn't published before
+the status response that updates the action to match).  Fields published within the last `fieldPublishThrottleMs`
+stay dirty until their throttle passes, so a flapping value can't flood the API.*/
+void MitsubishiUART::publishImmediateChanges() {
+  if (publishMode != PublishMode::immediate || dirtyFields == 0) return;
+
+  const uint32_t now = millis();
+  if (now - lastPublishMillis < minPublishIntervalMs) return;
+
+  uint16_t fields = 0;
+  for (uint8_t i = 0; i < DIRTY_FIELD_COUNT; i++) {
+    if ((dirtyFields & (1 << i)) && now - fieldPublishMillis[i] >= fieldPublishThrottleMs) fields |= 1 << i;
+  }
+  if (fields != 0) doPublish(fields);
+}
+
+// Publishes only the entities in `fields` marked dirty since they were last published, then clears them
+void MitsubishiUART::doPublish(const uint16_t fields) {
+  LoopMonitor::Scope timing(&loopMonitor, LoopStage::publish);
+  const uint16_t dirty = dirtyFields & fields;
+  dirtyFields &= ~fields;
+
+  const uint32_t now = millis();
+  lastPublishMillis = now;
+  for (uint8_t i = 0; i < DIRTY_FIELD_COUNT; i++) {
+    if (dirty & (1 << i)) fieldPublishMillis[i] = now;
+  }
+
+  if (dirty & DIRTY_CLIMATE) publish_state();
+  if (dirty & DIRTY_VANE_POSITION) vane_position_select->publish_state(vane_position_select->state);
+  if (dirty & DIRTY_HORIZONTAL_VANE_POSITION) {
+    horizontal_vane_position_select->publish_state(horizontal_vane_position_select->state);
+  }
+  // Writes to flash are collected and delayed, but there's no need to even schedule one unless the source changed
+  if (dirty & DIRTY_TEMPERATURE_SOURCE) save_preferences();
+
+  // Packet data is written directly to sensors' `raw_state` (or `state` for binary sensors) as packets arrive,
+  // and only published here, so a burst of packets results in at most one publish per sensor.
+  if (thermostat_temperature_sensor && (dirty & DIRTY_THERMOSTAT_TEMPERATURE)) {
     ESP_LOGI(TAG, "Thermostat temp differs, do publish");
     thermostat_temperature_sensor->publish_state(thermostat_temperature_sensor->raw_state);
   }
-  if (compressor_frequency_sensor && (compressor_frequency_sensor->raw_state != compressor_frequency_sensor->state)) {
+  if (compressor_frequency_sensor && (dirty & DIRTY_COMPRESSOR_FREQUENCY)) {
     ESP_LOGI(TAG, "Compressor frequency differs, do publish");
     compressor_frequency_sensor->publish_state(compressor_frequency_sensor->raw_state);
   }
-  if (actual_fan_sensor && (actual_fan_sensor->raw_state != actual_fan_sensor->state)) {
+  if (actual_fan_sensor && (dirty & DIRTY_ACTUAL_FAN)) {
     ESP_LOGI(TAG, "Actual fan speed differs, do publish");
     actual_fan_sensor->publish_state(actual_fan_sensor->raw_state);
   }
-  if (error_code_sensor && (error_code_sensor->raw_state != error_code_sensor->state)) {
+  if (error_code_sensor && (dirty & DIRTY_ERROR_CODE)) {
     ESP_LOGI(TAG, "Error code state differs, do publish");
     error_code_sensor->publish_state(error_code_sensor->raw_state);
   }
 
-  // Binary sensors automatically dedup publishes (I think) and so will only actually publish on change
-  service_filter_sensor->publish_state(service_filter_sensor->state);
-  defrost_sensor->publish_state(defrost_sensor->state);
-  hot_adjust_sensor->publish_state(hot_adjust_sensor->state);
-  standby_sensor->publish_state(standby_sensor->state);
+  if (service_filter_sensor && (dirty & DIRTY_SERVICE_FILTER)) service_filter_sensor->publish_state(service_filter_sensor->state);
+  if (defrost_sensor && (dirty & DIRTY_DEFROST)) defrost_sensor->publish_state(defrost_sensor->state);
+  if (hot_adjust_sensor && (dirty & DIRTY_HOT_ADJUST)) hot_adjust_sensor->publish_state(hot_adjust_sensor->state);
+  if (standby_sensor && (dirty & DIRTY_STANDBY)) standby_sensor->publish_state(standby_sensor->state);
 }
 
 bool MitsubishiUART::select_temperature_source(const std::string &state) {
   // TODO: Possibly check to see if state is available from the select options?  (Might be a bit redundant)
 
+  markDirty(DIRTY_TEMPERATURE_SOURCE, currentTemperatureSource != state);
   currentTemperatureSource = state;
-  //Reset the timeout for received temperature (without this, the menu dropdown will switch back to Internal temporarily)
-  lastReceivedTemperature = millis();
-
-  // If we've switched to internal, let the HP know right away
-  if (TEMPERATURE_SOURCE_INTERNAL == state) {
-    IFACTIVE(hp_bridge.sendPacket(RemoteTemperatureSetRequestPacket().useInternalTemperature());)
-  }
+  // Let the HP know right away, using the source's last reading if it has one
+  useTemperatureSource(state);
 
   return true;
 }
 
-bool MitsubishiUART::select_vane_position(const std::string &state) {
+bool MitsubishiUART::select_vane_position(const size_t index) {
   IFNOTACTIVE(return false;) // Skip this if we're not in active mode
-  SettingsSetRequestPacket::VANE_BYTE positionByte = SettingsSetRequestPacket::VANE_AUTO;
-
-  // NOTE: Annoyed that C++ doesn't have switches for strings, but since this is going to be called
-  // infrequently, this is probably a better solution than over-optimizing via maps or something
-
-  if (state == "Auto") {
-    positionByte = SettingsSetRequestPacket::VANE_AUTO;
-  } else if (state == "1") {
-    positionByte = SettingsSetRequestPacket::VANE_1;
-  } else if (state == "2") {
-    positionByte = SettingsSetRequestPacket::VANE_2;
-  } else if (state == "3") {
-    positionByte = SettingsSetRequestPacket::VANE_3;
-  } else if (state == "4") {
-    positionByte = SettingsSetRequestPacket::VANE_4;
-  } else if (state == "5") {
-    positionByte = SettingsSetRequestPacket::VANE_5;
-  } else if (state == "Swing") {
-    positionByte = SettingsSetRequestPacket::VANE_SWING;
-  } else {
-    ESP_LOGW(TAG, "Unknown vane position %s", state.c_str());
+
+  const VaneMapping *vane = mappingAt(VANE_MAPPINGS, index);
+  if (vane == nullptr) {
+    ESP_LOGW(TAG, "Unknown vane position %zu", index);
     return false;
   }
 
-
-  hp_bridge.sendPacket(SettingsSetRequestPacket().setVane(positionByte));
+  sendSettings(SettingsSetRequestPacket::create().setVane(vane->byte));
   return true;
 }
 
-bool MitsubishiUART::select_horizontal_vane_position(const std::string &state) {
+bool MitsubishiUART::select_horizontal_vane_position(const size_t index) {
   IFNOTACTIVE(return false;) // Skip this if we're not in active mode
-  SettingsSetRequestPacket::HORIZONTAL_VANE_BYTE positionByte = SettingsSetRequestPacket::HV_CENTER;
-
-  // NOTE: Annoyed that C++ doesn't have switches for strings, but since this is going to be called
-  // infrequently, this is probably a better solution than over-optimizing via maps or something
-
-  if (state == "Auto") {
-    positionByte = SettingsSetRequestPacket::HV_AUTO;
-  } else if (state == "<<") {
-    positionByte = SettingsSetRequestPacket::HV_LEFT_FULL;
-  } else if (state == "<") {
-    positionByte = SettingsSetRequestPacket::HV_LEFT;
-  } else if (state == "|") {
-    positionByte = SettingsSetRequestPacket::HV_CENTER;
-  } else if (state == ">") {
-    positionByte = SettingsSetRequestPacket::HV_RIGHT;
-  } else if (state == ">>") {
-    positionByte = SettingsSetRequestPacket::HV_RIGHT_FULL;
-  } else if (state == "<>") {
-    positionByte = SettingsSetRequestPacket::HV_SPLIT;
-  } else if (state == "Swing") {
-    positionByte = SettingsSetRequestPacket::HV_SWING;
-  } else {
-    ESP_LOGW(TAG, "Unknown horizontal vane position %s", state.c_str());
+
+  const HorizontalVaneMapping *vane = mappingAt(HORIZONTAL_VANE_MAPPINGS, index);
+  if (vane == nullptr) {
+    ESP_LOGW(TAG, "Unknown horizontal vane position %zu", index);
     return false;
   }
 
-  hp_bridge.sendPacket(SettingsSetRequestPacket().setHorizontalVane(positionByte));
+  sendSettings(SettingsSetRequestPacket::create().setHorizontalVane(vane->byte));
   return true;
 }
 
-// Called by temperature_source sensors to report values.  Will only take action if the currentTemperatureSource
-// matches the incoming source.  Specifically this means that we are not storing any values
-// for sensors other than the current source, and selecting a different source won't have any
-// effect until that source reports a temperature.
-// TODO: ? Maybe store all temperatures (and report on them using internal sensors??) so that selecting a new
-// source takes effect immediately?  Only really needed if source sensors are configured with very slow update times.
+// Called by temperature_source sensors to report values.  Readings from every source are stored, so selecting (or
+// failing over to) a different source takes effect straight away, but only the source in use is sent to the heatpump.
 void MitsubishiUART::temperature_source_report(const std::string &temperature_source, const float &v) {
-  ESP_LOGI(TAG, "Received temperature from %s of %f. (Current source: %s)", temperature_source.c_str(), v, currentTemperatureSource.c_str());
+  ESP_LOGI(TAG, "Received temperature from %s of %f. (Current source: %s)", temperature_source.c_str(), v, activeTemperatureSource.c_str());
 
-  // Only proceed if the incomming source matches our chosen source.
-  if (currentTemperatureSource == temperature_source) {
+  if (!temperatureSources.record(temperature_source, v, millis())) {
+    ESP_LOGW(TAG, "Too many temperature sources, ignoring readings from %s", temperature_source.c_str());
+  }
 
+  if (temperature_source == currentTemperatureSource && activeTemperatureSource != currentTemperatureSource) {
+    // The selected source is back, so it takes over from Internal or whichever source was standing in for it
+    ESP_LOGI(TAG, "Temperature received, switching back to %s as source.", temperature_source.c_str());
+    useTemperatureSource(temperature_source);
+  } else if (temperature_source == activeTemperatureSource) {
     //Reset the timeout for received temperature
     lastReceivedTemperature = millis();
 
-    // Tell the heat pump about the temperature asap, but don't worry about setting it locally, the next update() will get it
-    IFACTIVE(
-    RemoteTemperatureSetRequestPacket pkt = RemoteTemperatureSetRequestPacket();
-    pkt.setRemoteTemperature(v);
-    hp_bridge.sendPacket(pkt);
-    )
-
-    // If we've changed the select to reflect a temporary reversion to a different source, change it back.
-    if (temperature_source_select->state != temperature_source) {
-      ESP_LOGI(TAG, "Temperature received, switching back to %s as source.", temperature_source.c_str());
-      temperature_source_select->publish_state(temperature_source);
-    }
+    // Tell the heat pump about the temperature if it changed enough to matter, but don't worry about setting it
+    // locally, the next update() will get it
+    remoteTemperatureFeed.report(v);
+    sendRemoteTemperatureIfDue();
+  } else {
+    return;
+  }
+
+  if (temperature_source_select->state != temperature_source) {
+    temperature_source_select->publish_state(temperature_source);
+  }
+}
+
+/* Starts feeding the heatpump from `source`, which is either the selected source or one standing in for it.  If the
+source has a recent reading it's sent straight away, rather than waiting for the source to report again.*/
+void MitsubishiUART::useTemperatureSource(const std::string &source) {
+  const uint32_t now = millis();
+  activeTemperatureSource = source;
+  // Readings from the previous source shouldn't be smoothed into (or hold back) the new one's
+  remoteTemperatureFeed.reset();
+  //Reset the timeout for received temperature (without this, the menu dropdown will switch back to Internal temporarily)
+  lastReceivedTemperature = now;
+
+  if (source == TEMPERATURE_SOURCE_INTERNAL) {
+    IFACTIVE(hp_bridge.sendPacket(RemoteTemperatureSetRequestPacket::create().useInternalTemperature());)
+    return;
+  }
+
+  if (const TemperatureSourceReading *reading = temperatureSources.fresh(source, now, TEMPERATURE_SOURCE_TIMEOUT_MS)) {
+    lastReceivedTemperature = reading->receivedMillis;
+    remoteTemperatureFeed.report(reading->temperature);
+    sendRemoteTemperatureIfDue();
+  }
+}
+
+/* If it's been too long since the source in use reported, switch to the freshest other source (if failover is
+enabled), or to Internal.  Either way the select shows the source in use, but currentTemperatureSource is kept so the
+selected source takes over again as soon as it reports.*/
+void MitsubishiUART::checkTemperatureSourceTimeout() {
+  if (activeTemperatureSource == TEMPERATURE_SOURCE_INTERNAL) return;
+
+  const uint32_t now = millis();
+  if (now - lastReceivedTemperature <= TEMPERATURE_SOURCE_TIMEOUT_MS) return;
+
+  const TemperatureSourceReading *standIn =
+      temperatureSourceFailover ? temperatureSources.freshest(now, TEMPERATURE_SOURCE_TIMEOUT_MS) : nullptr;
+  // Copied, since useTemperatureSource() replaces activeTemperatureSource
+  const std::string source = standIn ? standIn->source : TEMPERATURE_SOURCE_INTERNAL;
+
+  ESP_LOGW(TAG, "No temperature received from %s for %" PRIu32 " milliseconds, switching to %s source",
+           activeTemperatureSource.c_str(), TEMPERATURE_SOURCE_TIMEOUT_MS, source.c_str());
+  temperature_source_select->publish_state(source);
+  useTemperatureSource(source);
+}
+
+// Sends the temperature from the source in use to the heatpump, if the feed says it's due
+void MitsubishiUART::sendRemoteTemperatureIfDue() {
+  if (!active_mode || activeTemperatureSource == TEMPERATURE_SOURCE_INTERNAL) return;
+  const uint32_t now = millis();
+  if (!remoteTemperatureFeed.due(now)) return;
+
+  // If the queue is full it stays due, and is tried again next loop
+  if (hp_bridge.sendPacket(
+          RemoteTemperatureSetRequestPacket::create().setRemoteTemperature(remoteTemperatureFeed.temperature()))) {
+    remoteTemperatureFeed.markSent(now);
   }
 }
 
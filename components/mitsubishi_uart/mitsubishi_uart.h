@@ -9,28 +9,75 @@
 #include "esphome/components/sensor/sensor.h"
 #include "muart_packet.h"
 #include "muart_bridge.h"
+#include "muart_responsecache.h"
+#include "muart_state.h"
+#include "muart_mappings.h"
+#include "muart_coordinator.h"
+#include "muart_remotetemp.h"
 #include <map>
 
 namespace esphome {
 namespace mitsubishi_uart {
 
-static const char *TAG = "mitsubishi_uart";
+static const char *const TAG = "mitsubishi_uart";
 
 const uint8_t MUART_MIN_TEMP = 16;  // Degrees C
 const uint8_t MUART_MAX_TEMP = 31;  // Degrees C
 const float MUART_TEMPERATURE_STEP = 0.5;
 
-const std::string FAN_MODE_VERYHIGH = "Very High";
+const std::string FAN_MODE_VERYHIGH = CUSTOM_FAN_VERYHIGH;
 
 const std::string TEMPERATURE_SOURCE_INTERNAL = "Internal";
 const uint32_t TEMPERATURE_SOURCE_TIMEOUT_MS = 420000; // (7min) The heatpump will revert on its own in ~10min
 
 const std::string TEMPERATURE_SOURCE_THERMOSTAT = "Thermostat";
 
-// these names come from Kumo. They are bad, but I am also too lazy to think of better names. they also
-// may not map perfectly yet?
-const std::array<std::string, 7> ACTUAL_FAN_SPEED_NAMES = {"Off", "Very Low", "Quiet", "Low", "Powerful",
-                                                           "Super Powerful", "Super Quiet"};
+// How long polling stays at its fastest cadence after a control change
+const uint32_t POLL_BOOST_DURATION_MS = 30000;
+
+// How often bridge metric sensors are published (also the window for windowed metrics like round-trip percentiles)
+const uint32_t METRICS_PUBLISH_INTERVAL_MS = 60000;
+
+class MitsubishiUART;
+
+/* Polling cadence for a single GetCommand.  Each poll starts at minIntervalMs and doubles its
+interval (up to maxIntervalMs) every time the response is unchanged, dropping back to minIntervalMs
+as soon as the response changes or after a control change.  When several polls are due at once,
+the one with the lowest priority value is sent first.*/
+struct PollSchedule {
+  GetCommand command;
+  uint8_t priority;
+  uint32_t minIntervalMs;
+  uint32_t maxIntervalMs;
+
+  uint32_t intervalMs = minIntervalMs;
+  uint32_t lastPollMillis = 0;
+  bool polled = false;    // Has this been requested at least once
+  bool inFlight = false;  // Is a request waiting for its response
+  bool hasResponse = false;
+  uint8_t lastResponse[PACKET_MAX_SIZE]{};  // Used to detect changes between responses
+  MitsubishiUART *parent = nullptr;  // Set by the MitsubishiUART that owns the schedule, for response callbacks
+};
+
+/* Bits for MitsubishiUART::dirtyFields, marking which published entities have changed since the last publish.
+Every climate field shares one bit, since the climate entity is always published as a whole.*/
+const uint16_t DIRTY_CLIMATE = 1 << 0;  // Mode, target/current temperature, fan mode, or action
+const uint16_t DIRTY_VANE_POSITION = 1 << 1;
+const uint16_t DIRTY_HORIZONTAL_VANE_POSITION = 1 << 2;
+const uint16_t DIRTY_THERMOSTAT_TEMPERATURE = 1 << 3;
+const uint16_t DIRTY_COMPRESSOR_FREQUENCY = 1 << 4;
+const uint16_t DIRTY_ACTUAL_FAN = 1 << 5;
+const uint16_t DIRTY_SERVICE_FILTER = 1 << 6;
+const uint16_t DIRTY_DEFROST = 1 << 7;
+const uint16_t DIRTY_HOT_ADJUST = 1 << 8;
+const uint16_t DIRTY_STANDBY = 1 << 9;
+const uint16_t DIRTY_ERROR_CODE = 1 << 10;
+const uint16_t DIRTY_TEMPERATURE_SOURCE = 1 << 11;  // Selected source changed, so preferences need saving
+const uint8_t DIRTY_FIELD_COUNT = 12;
+const uint16_t DIRTY_ALL = (1 << DIRTY_FIELD_COUNT) - 1;
+
+// When changes are published: with the regular update(), or from loop() as soon as they arrive
+enum class PublishMode : uint8_t { update, immediate };
 
 class MitsubishiUART : public PollingComponent, public climate::Climate, public PacketProcessor {
  public:
@@ -40,7 +87,8 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
   MitsubishiUART(uart::UARTComponent *hp_uart_comp);
 
   // Used to restore state of previous MUART-specific settings (like temperature source or pass-thru mode)
-  // Most other climate-state is preserved by the heatpump itself and will be retrieved after connection
+  // Climate-state is preserved by the heatpump itself and will be retrieved after connection, but the last known
+  // state is shown until then
   void setup() override;
 
   // Called repeatedly (used for UART receiving/forwarding)
@@ -49,7 +97,7 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
   // Called periodically as PollingComponent (used for UART sending periodically)
   void update() override;
 
-  // Returns default traits for MUART
+  // Returns traits for MUART (the configured traits, limited to the heat pump's capabilities once they're known)
   climate::ClimateTraits traits() override { return climate_traits_; }
 
   // Returns a reference to traits for MUART to be used during configuration
@@ -67,6 +115,9 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
     ESP_LOGCONFIG(TAG, "Thermostat uart was set.");
     ts_uart = uart;
     ts_bridge = new ThermostatBridge(ts_uart, static_cast<PacketProcessor*>(this));
+    ts_bridge->set_loop_monitor(&loopMonitor);
+    ts_bridge->set_replay_mode(replayMode);
+    hp_bridge.set_reserve_thermostat_slot(true);
   }
 
   // Sensor setters
@@ -79,23 +130,79 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
   void set_standby_sensor(binary_sensor::BinarySensor *sensor) {standby_sensor = sensor;};
   void set_error_code_sensor(text_sensor::TextSensor *sensor) { error_code_sensor = sensor; };
 
+  // Bridge metric sensor setters
+  void set_heatpump_metric_sensor(BridgeMetric metric, sensor::Sensor *sensor) {
+    hp_metric_sensors[static_cast<uint8_t>(metric)] = sensor;};
+  void set_thermostat_metric_sensor(BridgeMetric metric, sensor::Sensor *sensor) {
+    ts_metric_sensors[static_cast<uint8_t>(metric)] = sensor;};
+
   // Select setters
   void set_temperature_source_select(select::Select *select) {temperature_source_select = select;};
   void set_vane_position_select(select::Select *select) {vane_position_select = select;};
   void set_horizontal_vane_position_select(select::Select *select) {horizontal_vane_position_select = select;};
 
   // Returns true if select was valid (even if not yet successful) to indicate select component
-  // should optimistically publish
+  // should optimistically publish.  Vane positions are given by option index, since the options are the
+  // names in VANE_MAPPINGS / HORIZONTAL_VANE_MAPPINGS, in order.
   bool select_temperature_source(const std::string &state);
-  bool select_vane_position(const std::string &state);
-  bool select_horizontal_vane_position(const std::string &state);
+  bool select_vane_position(size_t index);
+  bool select_horizontal_vane_position(size_t index);
 
   // Used by external sources to report a temperature
   void temperature_source_report(const std::string &temperature_source, const float &v);
 
+  /* Logs the frames recently sent and received by each bridge in the capture export format (see muart_capture.h).
+  Call from a lambda (e.g. on a button press) to get a protocol trace after something goes wrong.*/
+  void dump_packet_capture() const;
+  /* Replay mode: nothing is sent to the heatpump or the thermostat, so a capture can be replayed into the packet
+  handlers to see the state and entities it would have produced (see muart_replay.h).*/
+  void set_replay_mode(bool replay) {
+    replayMode = replay;
+    hp_bridge.set_replay_mode(replay);
+    if (ts_bridge) ts_bridge->set_replay_mode(replay);
+  };
+
   // Turns on or off actively sending packets
   void set_active_mode(const bool active) {active_mode = active;};
 
+  // Heatpump request scheduling
+  void set_max_requests_in_flight(uint8_t max_in_flight) { hp_bridge.set_max_requests_in_flight(max_in_flight); };
+  void set_request_retries(uint8_t retries) { hp_bridge.set_request_retries(retries); };
+  void set_settings_coalesce_window(uint32_t window_ms) { hp_bridge.set_settings_coalesce_window(window_ms); };
+  // How long heatpump responses are used to answer the thermostat (and our own polls) without asking again
+  void set_response_cache_ttl(uint32_t ttl_ms) { responseCache.set_ttl(ttl_ms); };
+
+  // Loop instrumentation: whether stage timings are logged (with the metrics), and the time budget per loop (0 for none)
+  void set_loop_timing(bool enabled) { loopMonitor.set_timing_enabled(enabled); };
+  void set_loop_budget(uint32_t budget_us) { loopMonitor.set_budget(budget_us); };
+
+  /* Immediate publish mode: publishes changes from loop() as soon as they're committed (see HeatpumpState), at
+  most once per `min_interval_ms`, with each field published at most once per `field_throttle_ms`.*/
+  void set_publish_mode(PublishMode publish_mode) { publishMode = publish_mode; };
+  void set_min_publish_interval(uint32_t min_interval_ms) { minPublishIntervalMs = min_interval_ms; };
+  void set_field_publish_throttle(uint32_t field_throttle_ms) { fieldPublishThrottleMs = field_throttle_ms; };
+
+  /* Remote temperature feed: a changed temperature is sent at most once per `min_interval_ms`, and an unchanged one
+  is re-sent every `keepalive_ms`.  `smoothing` (0-1) is the weight an exponential moving average gives to the
+  previous readings (0 to send readings as-is).*/
+  void set_remote_temperature_min_interval(uint32_t min_interval_ms) {
+    remoteTemperatureFeed.set_min_interval(min_interval_ms); };
+  void set_remote_temperature_keepalive(uint32_t keepalive_ms) { remoteTemperatureFeed.set_keepalive(keepalive_ms); };
+  void set_remote_temperature_smoothing(float smoothing) { remoteTemperatureFeed.set_smoothing(smoothing); };
+  // Whether a stale temperature source is replaced by the freshest other source, rather than by Internal
+  void set_temperature_source_failover(bool failover) { temperatureSourceFailover = failover; };
+
+  // Time after this unit's polls before another unit may poll, when more than one is configured
+  void set_poll_spacing(uint32_t spacing_ms) { PollCoordinator::instance().set_poll_spacing(pollUnit, spacing_ms); };
+
+  // The most recently committed heatpump state, which entities are derived from
+  const HeatpumpState &heatpump_state() const { return committedState; };
+  // Whether the committed state is still the one restored at boot, not yet confirmed by the heatpump
+  bool is_state_provisional() const { return stateProvisional; };
+
+  // How packets are described in logs (applies to all instances)
+  void set_packet_log_format(PacketLogFormat log_format) { Packet::set_log_format(log_format); };
+
   protected:
     void routePacket(const Packet &packet);
 
@@ -113,7 +220,25 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
     void processPacket(const RemoteTemperatureSetRequestPacket &packet);
     void processPacket(const SetResponsePacket &packet);
 
-    void doPublish();
+    // Heatpump state
+    void reportState(uint8_t group, bool changed);
+    void commitStateIfSettled();
+    void commitState();
+    void deriveEntities(uint8_t groups);
+    static climate::ClimateMode deriveMode(const HeatpumpState &state);
+    static climate::ClimateAction deriveAction(const HeatpumpState &state, climate::ClimateAction previous_action);
+
+    // Publishes the entities in `fields` that are marked dirty
+    void doPublish(uint16_t fields = DIRTY_ALL);
+    void publishImmediateChanges();
+
+    // Polling
+    void runPollSchedule();
+    void pollCompleted(PollSchedule &poll, const RawPacket *response);
+    void boostPolling();
+
+    // Sends a settings change, after which settings entities are re-derived whether the change took or not
+    void sendSettings(const SettingsSetRequestPacket &packet);
 
   private:
     // Default climate_traits for MUART
@@ -138,15 +263,67 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
     uart::UARTComponent *ts_uart = nullptr;
     // UART packet wrapper for heatpump
     ThermostatBridge *ts_bridge = nullptr;
+    ResponseCache responseCache;
+    LoopMonitor loopMonitor;
+    bool yieldForBudget();
+
+    // The work in loop() that can be put off to the next iteration when the loop budget runs out, in order
+    enum class LoopWork : uint8_t {
+      heatpump_receive,
+      thermostat_receive,
+      heatpump_send,
+      thermostat_send,
+      requests,  // Due polls and remote temperature updates
+    };
+    static const uint8_t LOOP_WORK_COUNT = 5;
+    void runLoopWork(LoopWork work);
+    // Where the next loop() starts: the work that was skipped when the budget ran out, or the beginning
+    uint8_t loopResumeWork = 0;
 
 
     // Are we connected to the heatpump?
     bool hpConnected = false;
-    // Should we call publish on the next update?
-    bool publishOnUpdate = false;
-
-    optional<ExtendedConnectResponsePacket> _capabilitiesCache;
-    bool _capabilitiesRequested = false;
+    bool replayMode = false;
+    // DIRTY_* bits for everything that should be published on the next update
+    uint16_t dirtyFields = 0;
+    void markDirty(uint16_t fields, bool changed = true) { if (changed) dirtyFields |= fields; };
+
+    PublishMode publishMode = PublishMode::update;
+    uint32_t minPublishIntervalMs = 250;
+    uint32_t fieldPublishThrottleMs = 1000;
+    uint32_t lastPublishMillis = 0;
+    std::array<uint32_t, DIRTY_FIELD_COUNT> fieldPublishMillis{};  // When each DIRTY_* field was last published
+
+    // State being updated by packets as they arrive, and the snapshot of it last committed
+    HeatpumpState workingState;
+    HeatpumpState committedState;
+    uint8_t workingChanges = 0;         // STATE_* groups changed since the last commit
+    uint32_t workingChangedMillis = 0;  // When workingChanges last went from empty to non-empty
+    bool stateProvisional = false;      // Restored at boot, and no settings received since
+    uint8_t staleGroups = 0;            // STATE_* groups whose entities may not match the heatpump (see sendSettings)
+
+    // The persisted groups of the committed state are saved (coalesced) so they survive a reboot
+    void save_state_if_due();
+    void restore_state();
+    ESPPreferenceObject state_preferences_;
+    bool stateSavePending = false;
+    uint32_t lastStateSaveMillis = 0;
+
+    // Settings are polled before status so they usually arrive in the same poll cycle
+    std::array<PollSchedule, 5> pollSchedules = {{
+      {GetCommand::settings, 0, 5000, 30000},
+      {GetCommand::status, 1, 2000, 20000},
+      {GetCommand::current_temp, 2, 5000, 30000},
+      {GetCommand::standby, 3, 10000, 60000},
+      {GetCommand::error_info, 4, 30000, 300000},
+    }};
+    uint32_t pollBoostUntil = 0;
+    uint8_t pollUnit;  // This unit's index with the PollCoordinator
+
+    optional<OwnedPacket<ExtendedConnectResponsePacket>> _capabilitiesCache;
+    // Traits as configured, before being limited by capabilities
+    climate::ClimateTraits configured_traits_;
+    void applyCapabilities(const ExtendedConnectResponsePacket &capabilities);
 
     // Preferences
     void save_preferences();
@@ -154,6 +331,11 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
 
     ESPPreferenceObject preferences_;
 
+    // Capabilities are persisted separately (and survive firmware updates), so they're only written when they change
+    void save_capabilities(const ExtendedConnectResponsePacket &capabilities);
+    void restore_capabilities();
+    ESPPreferenceObject capabilities_preferences_;
+
     // Internal sensors
     sensor::Sensor *thermostat_temperature_sensor = nullptr;
     sensor::Sensor *compressor_frequency_sensor = nullptr;
@@ -164,6 +346,13 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
     binary_sensor::BinarySensor *standby_sensor = nullptr;
     text_sensor::TextSensor *error_code_sensor = nullptr;
 
+    // Bridge metric sensors, indexed by BridgeMetric
+    std::array<sensor::Sensor *, BRIDGE_METRIC_COUNT> hp_metric_sensors{};
+    std::array<sensor::Sensor *, BRIDGE_METRIC_COUNT> ts_metric_sensors{};
+    uint32_t lastMetricsPublish = 0;
+    void publishMetrics();
+    static void publishBridgeMetrics(MUARTBridge &bridge, const std::array<sensor::Sensor *, BRIDGE_METRIC_COUNT> &sensors);
+
     // Selects
     select::Select *temperature_source_select;
     select::Select *vane_position_select;
@@ -171,13 +360,44 @@ class MitsubishiUART : public PollingComponent, public climate::Climate, public
 
     // Temperature select extras
     std::map<std::string, size_t> temp_select_map; // Used to map strings to indexes for preference storage
-    std::string currentTemperatureSource = TEMPERATURE_SOURCE_INTERNAL;
-    uint32_t lastReceivedTemperature = millis();
+    std::string currentTemperatureSource = TEMPERATURE_SOURCE_INTERNAL;  // As selected (and saved)
+    std::string activeTemperatureSource = TEMPERATURE_SOURCE_INTERNAL;   // Feeding the heatpump (may be a stand-in)
+    uint32_t lastReceivedTemperature = millis();                         // From activeTemperatureSource
+    TemperatureSourceTable temperatureSources;
+    bool temperatureSourceFailover = true;
+    RemoteTemperatureFeed remoteTemperatureFeed;
+    void useTemperatureSource(const std::string &source);
+    void checkTemperatureSourceTimeout();
+    void sendRemoteTemperatureIfDue();
 
     void sendIfActive(const Packet& packet);
     bool active_mode = true;
 };
 
+// The last ExtendedConnectResponsePacket received, as its raw frame
+struct MUARTCapabilities {
+  uint8_t length = 0;
+  uint8_t frame[PACKET_MAX_SIZE]{};
+};
+// Mixed into the object hash to tell the capabilities preference apart from MUARTPreferences
+const uint32_t CAPABILITIES_PREFERENCE_KEY = 0x43415042;  // "CAPB"
+
+/* The STATE_PERSISTED groups of the last committed HeatpumpState.  Kept separate from HeatpumpState so its layout
+only changes deliberately; bump STATE_PREFERENCE_VERSION when it does, and older saves will be ignored.*/
+struct MUARTLastState {
+  uint8_t version = 0;
+  uint8_t received = 0;  // STATE_PERSISTED groups that had been reported when this was saved
+  bool power = false;
+  uint8_t mode = 0;
+  uint8_t fan = 0;
+  uint8_t vane = 0;
+  uint8_t horizontalVane = 0;
+  float targetTemperature = NAN;
+  float currentTemperature = NAN;
+};
+const uint8_t STATE_PREFERENCE_VERSION = 1;
+const uint32_t STATE_PREFERENCE_KEY = 0x53544154;  // "STAT"
+
 struct MUARTPreferences {
   optional<size_t> currentTemperatureSourceIndex = nullopt;  // Index of selected value
   //optional<uint32_t> currentTemperatureSourceHash = nullopt; // Hash of selected value (to make sure it hasn't changed since last save)
@@ -1,199 +1,336 @@
 #include "muart_bridge.h"
+#include "muart_packet_dispatch.h"
+#include <cinttypes>
 
 namespace esphome {
 namespace mitsubishi_uart {
 
 MUARTBridge::MUARTBridge(uart::UARTComponent *uart_component, PacketProcessor *packet_processor) : uart_comp{*uart_component}, pkt_processor{*packet_processor} {}
 
-// The heatpump loop expects responses for most sent packets, so it tracks the last send packet and wait for a response
-void HeatpumpBridge::loop() {
-
-  // Try to get a packet
-  if (optional<RawPacket> pkt = receiveRawPacket(SourceBridge::heatpump, packetAwaitingResponse.has_value() ? packetAwaitingResponse.value().getControllerAssociation() : ControllerAssociation::muart)) {
-    ESP_LOGV(BRIDGE_TAG, "Parsing %x heatpump packet", pkt.value().getPacketType());
+// The heatpump expects responses for most sent packets, so sent requests are tracked and responses matched to them
+void HeatpumpBridge::receivePackets() {
+  while (RawPacket *pkt = receiveRawPacket(SourceBridge::heatpump, ControllerAssociation::muart)) {
+    ESP_LOGV(BRIDGE_TAG, "Parsing %x heatpump packet", pkt->getPacketType());
     // Check the packet's checksum and either process it, or log an error
-    if (pkt.value().isChecksumValid()) {
-      // If we're waiting for a response, associate the incomming packet with the request packet
-      classifyAndProcessRawPacket(pkt.value());
+    if (pkt->isChecksumValid()) {
+      // If this is a response to one of our pending requests, associate it with the controller that sent the request
+      PendingRequest *request = matchPendingRequest(*pkt);
+      if (request) {
+        pkt->setControllerAssociation(request->packet.getControllerAssociation());
+      }
+
+      classifyAndProcessRawPacket(*pkt);
+
+      if (request) {
+        completePendingRequest(*request, pkt);
+      }
     } else {
-      ESP_LOGW(BRIDGE_TAG, "Invalid packet checksum!\n%s", format_hex_pretty(&pkt.value().getBytes()[0], pkt.value().getLength()).c_str());
+      ESP_LOGW(BRIDGE_TAG, "Invalid packet checksum!\n%s", format_hex_pretty(&pkt->getBytes()[0], pkt->getLength()).c_str());
     }
 
-    // If there was a packet waiting for a response, remove it.
-    // TODO: This incoming packet wasn't *nessesarily* a response, but for now
-    // it's probably not worth checking to make sure it matches.
-    if (packetAwaitingResponse.has_value()) {
-      packetAwaitingResponse.reset();
-    }
-  } else if (!packetAwaitingResponse.has_value() && !pkt_queue.empty()) {
-    // If we're not waiting for a response and there's a packet in the queue...
+    // Anything else that's arrived can wait in the UART's buffer until the next loop
+    if (budgetExhausted()) break;
+  }
+}
 
-    // If the packet expects a response, add it to the awaitingResponse variable
-    if (pkt_queue.front().isResponseExpected()){
-      packetAwaitingResponse = pkt_queue.front();
-    }
+void HeatpumpBridge::sendPackets() {
+  // Resend or give up on any requests that have waited too long
+  checkPendingRequests();
 
-    ESP_LOGV(BRIDGE_TAG, "Sending to heatpump %s", pkt_queue.front().to_string().c_str());
-    writeRawPacket(pkt_queue.front().rawPacket());
-    packet_sent_millis = millis();
+  QueueLane lane;
+  while (nextLane(lane)) {
+    sendQueuedPacket(lane);
+    if (budgetExhausted()) break;
+  }
+}
 
-    // Remove packet from queue
-    pkt_queue.pop();
-  } else if (packetAwaitingResponse.has_value() && (millis() - packet_sent_millis > RESPONSE_TIMEOUT_MS)) {
-    // We've been waiting too long for a response, give up
-    // TODO: We could potentially retry here, but that seems unnecessary
-    packetAwaitingResponse.reset();
-    ESP_LOGW(BRIDGE_TAG, "Timeout waiting for response to %x packet.", packetAwaitingResponse.value().getPacketType());
+// Picks the lane to send from next, returning false if nothing should be sent right now
+bool HeatpumpBridge::nextLane(QueueLane &lane) {
+  const uint8_t pending = pendingRequestCount();
+  if (pending >= maxRequestsInFlight) return false;
+
+  if (pkt_queue.front(QueueLane::thermostat)) {
+    lane = QueueLane::thermostat;
+    return true;
+  }
+
+  const uint8_t reserved = (reserveThermostatSlot && maxRequestsInFlight > 1) ? 1 : 0;
+  if (pkt_queue.front(QueueLane::control) && pending + reserved < maxRequestsInFlight) {
+    lane = QueueLane::control;
+    return true;
+  }
+
+  // Polls wait until nothing else is queued (including a settings change held in the control lane) and the
+  // thermostat isn't waiting on the heatpump
+  if (pkt_queue.front(QueueLane::poll) && pending + reserved < maxRequestsInFlight
+      && pkt_queue.size(QueueLane::control) == 0 && pendingRequestCount(ControllerAssociation::thermostat) == 0) {
+    lane = QueueLane::poll;
+    return true;
   }
+
+  return false;
 }
 
-// The thermostat bridge loop doesn't expect any responses, so packets in queue are just sent without checking if they expect a response
-void ThermostatBridge::loop() {
-  // Try to get a packet
-  if (optional<RawPacket> pkt = receiveRawPacket(SourceBridge::thermostat, ControllerAssociation::thermostat)) {
-    ESP_LOGV(BRIDGE_TAG, "Parsing %x thermostat packet", pkt.value().getPacketType());
+// The thermostat doesn't send responses, so packets are processed as they arrive and sent without waiting
+void ThermostatBridge::receivePackets() {
+  while (RawPacket *pkt = receiveRawPacket(SourceBridge::thermostat, ControllerAssociation::thermostat)) {
+    ESP_LOGV(BRIDGE_TAG, "Parsing %x thermostat packet", pkt->getPacketType());
     // Check the packet's checksum and either process it, or log an error
-    if (pkt.value().isChecksumValid()) {
-      classifyAndProcessRawPacket(pkt.value());
+    if (pkt->isChecksumValid()) {
+      classifyAndProcessRawPacket(*pkt);
     } else {
-      ESP_LOGW(BRIDGE_TAG, "Invalid packet checksum!\n%s", format_hex_pretty(&pkt.value().getBytes()[0], pkt.value().getLength()).c_str());
+      ESP_LOGW(BRIDGE_TAG, "Invalid packet checksum!\n%s", format_hex_pretty(&pkt->getBytes()[0], pkt->getLength()).c_str());
     }
-  } else if (!pkt_queue.empty()) {
-    // If there's a packet in the queue...
 
-    ESP_LOGV(BRIDGE_TAG, "Sending to thermostat %s", pkt_queue.front().to_string().c_str());
-    writeRawPacket(pkt_queue.front().rawPacket());
+    if (budgetExhausted()) break;
+  }
+}
+
+void ThermostatBridge::sendPackets() {
+  while (QueuedFrame *frame = pkt_queue.front()) {
+    LOGFRAMEV(BRIDGE_TAG, "Sending to thermostat %s", frame->bytes, frame->length);
+    writeRawPacket(frame->rawPacket());
     packet_sent_millis = millis();
 
     // Remove packet from queue
     pkt_queue.pop();
+
+    if (budgetExhausted()) break;
   }
 }
 
 /* Queues a packet to be sent by the bridge.  If the queue is full, the packet will not be
 enqueued.*/
-void MUARTBridge::sendPacket(const Packet &packetToSend) {
-  if (pkt_queue.size() <= MAX_QUEUE_SIZE) {
-    pkt_queue.push(packetToSend) ;
-  } else {
+bool MUARTBridge::sendPacket(const Packet &packetToSend, const ResponseCallback &callback) {
+  // The capture being replayed already has whatever this packet led to
+  if (replayMode) return false;
+
+  if (!pkt_queue.push(packetToSend, callback)) {
     ESP_LOGW(BRIDGE_TAG, "Packet queue full!  %x packet not sent.", packetToSend.getPacketType());
+    bridgeMetrics.queueFullDrops++;
+    if (callback) callback(nullptr);
+    return false;
+  }
+  bridgeMetrics.recordQueueDepth(pkt_queue.size());
+  return true;
+}
+
+// Sends the packet at the front of `lane`, tracking it as pending if it expects a response
+void MUARTBridge::sendQueuedPacket(const QueueLane lane) {
+  QueuedFrame &queued = *pkt_queue.front(lane);
+  const RawPacket raw = queued.rawPacket();
+  const bool responseExpected = queued.responseExpected;
+  const ResponseCallbacks callbacks = queued.callbacks;
+
+  // Remove packet from queue before anything can call back into sendPacket
+  pkt_queue.pop(lane);
+
+  LOGFRAMEV(BRIDGE_TAG, "Sending to heatpump %s", raw.getBytes(), raw.getLength());
+  writeRawPacket(raw);
+  packet_sent_millis = millis();
+
+  if (responseExpected) {
+    for (PendingRequest &request : pendingRequests) {
+      if (request.active) continue;
+      request.packet = raw;
+      request.callbacks = callbacks;
+      request.sequence = requestSequence++;
+      request.timerMillis = packet_sent_millis;
+      request.attempts = 1;
+      request.awaitingRetry = false;
+      request.active = true;
+      break;
+    }
+  } else {
+    // Nothing to wait for, so the request is complete as soon as it's sent
+    callbacks.complete(nullptr);
+  }
+}
+
+/* Finds the oldest pending request answered by `response`.  Responses have the request's packet type with
+PACKET_TYPE_RESPONSE_FLAG set, and get responses also echo the requested command.  Set responses carry a
+result code in place of the command, so they're matched on packet type alone. Returns nullptr if there's no match.*/
+MUARTBridge::PendingRequest *MUARTBridge::matchPendingRequest(const RawPacket &response) {
+  PendingRequest *match = nullptr;
+
+  for (PendingRequest &request : pendingRequests) {
+    if (!request.active) continue;
+    if ((request.packet.getPacketType() | PACKET_TYPE_RESPONSE_FLAG) != response.getPacketType()) continue;
+    if (request.packet.getPacketType() == static_cast<uint8_t>(PacketType::get_request)
+        && request.packet.getCommand() != response.getCommand()) continue;
+    if (match == nullptr || (int32_t) (request.sequence - match->sequence) < 0) {
+      match = &request;
+    }
   }
+
+  return match;
+}
+
+void MUARTBridge::completePendingRequest(PendingRequest &request, const RawPacket *response) {
+  if (response && !request.awaitingRetry) bridgeMetrics.recordRoundTrip(millis() - request.timerMillis);
+
+  // Release the slot before calling back, in case the callback sends another packet
+  const ResponseCallbacks callbacks = request.callbacks;
+  request.callbacks.clear();
+  request.active = false;
+
+  callbacks.complete(response);
+}
+
+/* Resends requests that timed out after a backoff delay, or gives up on them once they're out of retries.
+Requests forwarded on behalf of the thermostat aren't retried, since the thermostat will retry them itself.*/
+void MUARTBridge::checkPendingRequests() {
+  const uint32_t now = millis();
+
+  for (PendingRequest &request : pendingRequests) {
+    if (!request.active) continue;
+
+    if (request.awaitingRetry) {
+      if (now - request.timerMillis >= (RETRY_BACKOFF_MS << (request.attempts - 1))) {
+        ESP_LOGD(BRIDGE_TAG, "Resending %x packet (attempt %i).", request.packet.getPacketType(), request.attempts + 1);
+        writeRawPacket(request.packet);
+        packet_sent_millis = now;
+        request.timerMillis = now;
+        request.attempts++;
+        request.awaitingRetry = false;
+      }
+    } else if (now - request.timerMillis > RESPONSE_TIMEOUT_MS) {
+      bridgeMetrics.responseTimeouts++;
+      if (request.packet.getControllerAssociation() == ControllerAssociation::muart && request.attempts <= requestRetries) {
+        ESP_LOGW(BRIDGE_TAG, "Timeout waiting for response to %x packet, will retry.", request.packet.getPacketType());
+        request.timerMillis = now;
+        request.awaitingRetry = true;
+      } else {
+        ESP_LOGW(BRIDGE_TAG, "Timeout waiting for response to %x packet.", request.packet.getPacketType());
+        completePendingRequest(request, nullptr);
+      }
+    }
+  }
+}
+
+bool MUARTBridge::requestsSettled() const {
+  return pkt_queue.size(QueueLane::control) == 0 && pkt_queue.size(QueueLane::poll) == 0
+      && pendingRequestCount(ControllerAssociation::muart) == 0;
 }
 
-void MUARTBridge::writeRawPacket(const RawPacket &packetToSend) const {
+uint8_t MUARTBridge::pendingRequestCount() const {
+  uint8_t count = 0;
+  for (const PendingRequest &request : pendingRequests) {
+    if (request.active) count++;
+  }
+  return count;
+}
+
+uint8_t MUARTBridge::pendingRequestCount(const ControllerAssociation controller_association) const {
+  uint8_t count = 0;
+  for (const PendingRequest &request : pendingRequests) {
+    if (request.active && request.packet.getControllerAssociation() == controller_association) count++;
+  }
+  return count;
+}
+
+void MUARTBridge::writeRawPacket(const RawPacket &packetToSend) {
   uart_comp.write_array(packetToSend.getBytes(), packetToSend.getLength());
+  bridgeMetrics.framesSent++;
+  bridgeMetrics.recordBytes(packetToSend.getLength());
+  pkt_capture.record(packetToSend.getBytes(), packetToSend.getLength(), sourceBridge(), true, packetToSend.isChecksumValid());
 }
 
 /* Reads and deserializes a packet from UART.
-Communication with heatpump is *slow*, so we need to check and make sure there are
-enough packets available before we start reading.  If there aren't enough packets,
-no packet will be returned.
-
-Even at 2400 baud, the 100ms readtimeout should be enough to read a whole payload
-after the first byte has been received though, so currently we're assuming that once
-the header is available, it's safe to call read_array without timing out and severing
-the packet.
+Communication with heatpump is *slow*, so rather than waiting for a whole packet to arrive, this
+consumes only the bytes that are already available and keeps any partial frame in the FrameParser until
+the next call.  This means it never blocks on the UART's read timeout.  Returns the packet once the
+checksum byte of a frame has been read, otherwise returns nullptr.  The returned packet is owned by the
+bridge and is only valid until the next call.
 */
-const optional<RawPacket> MUARTBridge::receiveRawPacket(const SourceBridge source_bridge, const ControllerAssociation controller_association) const {
+RawPacket *MUARTBridge::receiveRawPacket(const SourceBridge source_bridge, const ControllerAssociation controller_association) {
   // TODO: Can we make the source_bridge and controller_association inherent to the class instead of passed as arguments?
-  uint8_t packetBytes[PACKET_MAX_SIZE];
-  packetBytes[0] = 0;  // Reset control byte before starting
+  uint8_t byte;
 
-  // Drain UART until we see a control byte (times out after 100ms in UARTComponent)
-  while (uart_comp.available() >= PACKET_HEADER_SIZE && uart_comp.read_byte(&packetBytes[0])) {
-    if (packetBytes[0] == BYTE_CONTROL) break;
-    // TODO: If the serial is all garbage, this may never stop-- we should have our own timeout
+  RawPacket *received = nullptr;
+  const uint32_t now = millis();
+  while (received == nullptr && uart_comp.available() > 0 && uart_comp.read_byte(&byte)) {
+    if (frameParser.parse(byte, now)) {
+      receivedPacket = RawPacket(frameParser.frame(), frameParser.length(), source_bridge, controller_association);
+      pkt_capture.record(frameParser.frame(), frameParser.length(), source_bridge, false, receivedPacket.isChecksumValid());
+      bridgeMetrics.framesReceived++;
+      bridgeMetrics.recordBytes(frameParser.length());
+      if (!receivedPacket.isChecksumValid()) bridgeMetrics.checksumFailures++;
+      received = &receivedPacket;
+    }
   }
 
-  // If we never found a control byte, we didn't receive a packet
-  if (packetBytes[0] != BYTE_CONTROL) {
-    return nullopt;
+  /* Only checked once the UART's buffer is empty: bytes that arrived while the loop was busy are still waiting
+  to be read, so time between reads alone doesn't mean the line went quiet.  At least 1ms, for fast baud rates.*/
+  const uint32_t baudRate = uart_comp.get_baud_rate();
+  if (received == nullptr && baudRate > 0) {
+    const uint32_t characterBits = 11;  // Start, 8 data, parity and stop
+    const uint32_t gapMs = std::max<uint32_t>(1, FRAME_GAP_CHARACTERS * characterBits * 1000 / baudRate);
+    frameParser.expirePartialFrame(now, gapMs);
   }
 
-  // Read the header
-  uart_comp.read_array(&packetBytes[1], PACKET_HEADER_SIZE - 1);
+  bridgeMetrics.resyncs = frameParser.resyncCount();
+  return received;
+}
+
+/* Adds a byte to the frame being parsed.  Garbage on the line is discarded a byte at a time until a
+control byte is seen.  Returns true once the checksum byte of a frame has been added.*/
+bool FrameParser::parse(const uint8_t byte, const uint32_t now) {
+  lastByteMillis = now;
+  switch (readState) {
+    case ReadState::sync:
+      if (byte == BYTE_CONTROL) {
+        readBuffer[0] = byte;
+        readIndex = 1;
+        readState = ReadState::header;
+        discarding = false;
+      } else if (!discarding) {
+        discarding = true;
+        resyncs++;
+      }
+      break;
+
+    case ReadState::header:
+      readBuffer[readIndex++] = byte;
+      if (readIndex == PACKET_HEADER_SIZE) {
+        // A payload that won't fit in a packet means we synced on a stray control byte; start over
+        if (readBuffer[PACKET_HEADER_INDEX_PAYLOAD_LENGTH] > PACKET_MAX_SIZE - PACKET_HEADER_SIZE - 1) {
+          ESP_LOGW(BRIDGE_TAG, "Invalid payload length %i, resyncing.", readBuffer[PACKET_HEADER_INDEX_PAYLOAD_LENGTH]);
+          readState = ReadState::sync;
+          resyncs++;
+        } else {
+          readState = readBuffer[PACKET_HEADER_INDEX_PAYLOAD_LENGTH] > 0 ? ReadState::payload : ReadState::checksum;
+        }
+      }
+      break;
 
-  // Read payload + checksum
-  uint8_t payloadSize = packetBytes[PACKET_HEADER_INDEX_PAYLOAD_LENGTH];
-  uart_comp.read_array(&packetBytes[PACKET_HEADER_SIZE], payloadSize + 1);
+    case ReadState::payload:
+      readBuffer[readIndex++] = byte;
+      if (readIndex == PACKET_HEADER_SIZE + readBuffer[PACKET_HEADER_INDEX_PAYLOAD_LENGTH]) {
+        readState = ReadState::checksum;
+      }
+      break;
+
+    case ReadState::checksum:
+      readBuffer[readIndex++] = byte;
+      readState = ReadState::sync;
+      return true;
+  }
 
-  return RawPacket(packetBytes, PACKET_HEADER_SIZE + payloadSize + 1, source_bridge, controller_association);
+  return false;
 }
 
-template <class P>
-void MUARTBridge::processRawPacket(RawPacket &pkt, bool expectResponse) const {
-  P packet = P(std::move(pkt));
-  packet.setResponseExpected(expectResponse);
-  pkt_processor.processPacket(packet);
+void FrameParser::expirePartialFrame(const uint32_t now, const uint32_t gap_ms) {
+  if (readState == ReadState::sync || now - lastByteMillis <= gap_ms) return;
+  ESP_LOGW(BRIDGE_TAG, "Dropping partial frame of %i bytes after %" PRIu32 "ms without data.", readIndex, gap_ms);
+  readState = ReadState::sync;
+  resyncs++;
 }
 
+// Looks up the packet in PACKET_DISPATCH_TABLE and hands it to the PacketProcessor as the registered packet class
 void MUARTBridge::classifyAndProcessRawPacket(RawPacket &pkt) const {
-  // Figure out how to do this without a static_cast?
-  switch (static_cast<PacketType>(pkt.getPacketType()))
-  {
-  case PacketType::connect_request :
-    processRawPacket<ConnectRequestPacket>(pkt, true);
-    break;
-  case PacketType::connect_response :
-    processRawPacket<ConnectResponsePacket>(pkt, false);
-    break;
-
-  case PacketType::extended_connect_request :
-    processRawPacket<ExtendedConnectRequestPacket>(pkt, true);
-    break;
-  case PacketType::extended_connect_response :
-    processRawPacket<ExtendedConnectResponsePacket>(pkt, false);
-    break;
-
-  case PacketType::get_request :
-    processRawPacket<GetRequestPacket>(pkt, true);
-    break;
-  case PacketType::get_response :
-    switch(static_cast<GetCommand>(pkt.getCommand())) {
-      case GetCommand::settings :
-        processRawPacket<SettingsGetResponsePacket>(pkt, false);
-        break;
-      case GetCommand::current_temp :
-        processRawPacket<CurrentTempGetResponsePacket>(pkt, false);
-        break;
-      case GetCommand::error_info :
-        processRawPacket<ErrorStateGetResponsePacket>(pkt, false);
-        break;
-      case GetCommand::standby :
-        processRawPacket<StandbyGetResponsePacket>(pkt, false);
-        break;
-      case GetCommand::status :
-        processRawPacket<StatusGetResponsePacket>(pkt, false);
-        break;
-      case GetCommand::a_9 :
-        processRawPacket<A9GetRequestPacket>(pkt, false);
-        break;
-      default:
-        processRawPacket<Packet>(pkt, false);
-    }
-    break;
-  case PacketType::set_request :
-    switch(static_cast<SetCommand>(pkt.getCommand())) {
-      case SetCommand::remote_temperature :
-        processRawPacket<RemoteTemperatureSetRequestPacket>(pkt, true);
-        break;
-      case SetCommand::settings :
-        processRawPacket<SettingsSetRequestPacket>(pkt, true);
-        break;
-      case SetCommand::thermostat_hello :
-        processRawPacket<ThermostatHelloRequestPacket>(pkt, false);
-        break;
-      default:
-        processRawPacket<Packet>(pkt, true);
-    }
-    break;
-  case PacketType::set_response :
-    processRawPacket<SetResponsePacket>(pkt, false);
-    break;
-
-  default:
-    processRawPacket<Packet>(pkt, true); // If we get an unknown packet from the thermostat, expect a response
-  }
+  LoopMonitor::Scope timing(loopMonitor, LoopStage::packet_handler);
+  dispatchRawPacket(pkt_processor, pkt);
 }
 
 }  // namespace mitsubishi_uart
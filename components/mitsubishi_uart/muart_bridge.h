@@ -2,54 +2,168 @@
 
 #include "esphome/components/uart/uart.h"
 #include "muart_packet.h"
-#include "queue"
+#include "muart_packetqueue.h"
+#include "muart_capture.h"
+#include "muart_metrics.h"
+#include "muart_looptiming.h"
 
 namespace esphome {
 namespace mitsubishi_uart {
 
-static const char *BRIDGE_TAG = "muart_bridge";
+static const char *const BRIDGE_TAG = "muart_bridge";
 static const uint32_t RESPONSE_TIMEOUT_MS = 3000; // Maximum amount of time to wait for an expected response packet
-/* Maximum number of packets allowed to be queued for sending.  In some circumstances the equipment response
-time can be very slow and packets would queue up faster than they were being received.  TODO: Not sure what size this should
-be, 4ish should be enough for almost all situations, so 8 seems plenty.*/
-static const size_t MAX_QUEUE_SIZE = 8;
+static const uint32_t RETRY_BACKOFF_MS = 500; // Delay before resending a timed-out request, doubled for each further attempt
+// Number of slots for requests awaiting a response.  How many are actually used is configurable up to this limit.
+static const uint8_t MAX_REQUESTS_IN_FLIGHT = 4;
+// A partial frame is dropped after this many character times without another byte
+static const uint8_t FRAME_GAP_CHARACTERS = 10;
+
+// Assembles frames from a stream of bytes, one byte at a time
+class FrameParser {
+  public:
+    // Adds a byte (read at `now`) to the frame being parsed, returning true if it completed a frame
+    bool parse(uint8_t byte, uint32_t now);
+    // Drops a partial frame if no byte has been added for `gap_ms`, so a truncated frame can't swallow the next one
+    void expirePartialFrame(uint32_t now, uint32_t gap_ms);
+    // The most recently completed frame (only valid after parse() returns true, until the next call)
+    const uint8_t *frame() const { return readBuffer; }
+    uint8_t length() const { return readIndex; }
+    // Number of times the parser lost sync and discarded data
+    uint32_t resyncCount() const { return resyncs; }
+
+  private:
+    // States of the incremental frame parser
+    enum class ReadState : uint8_t {
+      sync,     // Discarding bytes until a control byte is seen
+      header,   // Reading the rest of the header (packet type, unknown bytes, payload length)
+      payload,  // Reading payload bytes
+      checksum  // Waiting for the final checksum byte
+    };
+
+    ReadState readState = ReadState::sync;
+    uint8_t readBuffer[PACKET_MAX_SIZE]{};
+    uint8_t readIndex = 0;
+    uint32_t lastByteMillis = 0;
+    bool discarding = false;  // Has the current run of non-frame bytes been counted as a resync yet
+    uint32_t resyncs = 0;
+};
 
 // A UARTComponent wrapper to send and receieve packets
 class MUARTBridge  {
   public:
     MUARTBridge(uart::UARTComponent *uart_component, PacketProcessor *packet_processor);
 
-    // Enqueues a packet to be sent
-    void sendPacket(const Packet &packetToSend);
+    /* Enqueues a packet to be sent, optionally calling `callback` when its response arrives (or doesn't).  Returns
+    false if it wasn't enqueued (the queue is full, or in replay mode).*/
+    bool sendPacket(const Packet &packetToSend, const ResponseCallback &callback = nullptr);
 
+    // Number of requests that may be awaiting a response at the same time (1 to MAX_REQUESTS_IN_FLIGHT)
+    void set_max_requests_in_flight(uint8_t max_in_flight) { maxRequestsInFlight = std::min(std::max(max_in_flight, (uint8_t) 1), MAX_REQUESTS_IN_FLIGHT); };
+    // Number of times a request we generated is resent if no response is received
+    void set_request_retries(uint8_t retries) { requestRetries = retries; };
+    // How long settings changes wait to be merged with further changes before they're sent
+    void set_settings_coalesce_window(uint32_t window_ms) { pkt_queue.set_settings_coalesce_window(window_ms); };
+    /* Drops packets instead of queueing them (without calling their callbacks), so a capture can be replayed
+    through the real packet handlers without anything being sent (see muart_replay.h)*/
+    void set_replay_mode(bool replay) { replayMode = replay; };
+
+    // Processes every packet that has arrived since the last call
+    virtual void receivePackets() = 0;
+    // Sends as many queued packets as the bridge's arbitration allows
+    virtual void sendPackets() = 0;
     // Checks for incoming packets, processes them, sends queued packets
-    virtual void loop() = 0;
+    void loop() { receivePackets(); sendPackets(); };
+
+    // Have all of our own queued requests been sent and answered (or timed out)?  Thermostat traffic isn't counted.
+    bool requestsSettled() const;
+
+    // The most recent frames sent and received by this bridge
+    const PacketCapture &capture() const { return pkt_capture; };
+
+    // Current value of a bus health metric (see BridgeMetric)
+    float metric(BridgeMetric metric) const { return bridgeMetrics.value(metric, uart_comp.get_baud_rate()); };
+    // Starts a new window for the windowed metrics (e.g. after they've been published)
+    void resetMetricsWindow() { bridgeMetrics.resetWindow(); };
+
+    // Used to time packet handlers and to stop taking on work once the loop's time budget is used up
+    void set_loop_monitor(LoopMonitor *monitor) { loopMonitor = monitor; };
 
   protected:
-    const optional<RawPacket> receiveRawPacket(const SourceBridge source_bridge, const ControllerAssociation controller_association) const;
-    void writeRawPacket(const RawPacket &pkt) const;
-    template <class P>
-    void processRawPacket(RawPacket &pkt, bool expectResponse = true) const;
+    // Which side of the bridge this is, used to label captured frames
+    virtual SourceBridge sourceBridge() const = 0;
+
+    RawPacket *receiveRawPacket(const SourceBridge source_bridge, const ControllerAssociation controller_association);
+    void writeRawPacket(const RawPacket &pkt);
     void classifyAndProcessRawPacket(RawPacket &pkt) const;
 
+    // A request that has been sent and is waiting for its response (or for a retry)
+    struct PendingRequest {
+      RawPacket packet;
+      ResponseCallbacks callbacks;
+      uint32_t sequence;     // Order in which requests were sent, used to match responses to the oldest request first
+      uint32_t timerMillis;  // When the request was last sent, or when it started waiting to be resent
+      uint8_t attempts;      // Number of times the request has been sent
+      bool active = false;
+      bool awaitingRetry = false;
+    };
+
+    void sendQueuedPacket(QueueLane lane);
+    PendingRequest *matchPendingRequest(const RawPacket &response);
+    void completePendingRequest(PendingRequest &request, const RawPacket *response);
+    void checkPendingRequests();
+    uint8_t pendingRequestCount() const;
+    uint8_t pendingRequestCount(ControllerAssociation controller_association) const;
+
     uart::UARTComponent &uart_comp;
     PacketProcessor &pkt_processor;
-    std::queue<Packet> pkt_queue;
-    optional<Packet> packetAwaitingResponse = nullopt;
+    PacketQueue pkt_queue;
+    PacketCapture pkt_capture;
+    BridgeMetrics bridgeMetrics;
+    LoopMonitor *loopMonitor = nullptr;
+    bool budgetExhausted() const { return loopMonitor != nullptr && loopMonitor->budgetExhausted(); };
+    PendingRequest pendingRequests[MAX_REQUESTS_IN_FLIGHT];
+    uint8_t maxRequestsInFlight = 1;  // One request at a time unless pipelining is configured
+    uint8_t requestRetries = 2;
+    bool replayMode = false;
+    uint32_t requestSequence = 0;
     uint32_t packet_sent_millis;
+
+  private:
+    // Partially received frame, kept between calls to loop()
+    FrameParser frameParser;
+    // The most recently received packet.  Packets passed to the PacketProcessor are views over this.
+    RawPacket receivedPacket;
 };
 
+/* Arbitrates between the queue's lanes so the thermostat gets bounded latency without starving our own requests:
+  - Packets forwarded for the thermostat are sent whenever a request slot is free.
+  - Our own control packets are sent as long as a slot is left free for the thermostat (if one is connected).
+  - Polls are only sent when nothing else is queued and no thermostat request is waiting for a response, filling
+    otherwise idle bus time (while still leaving the thermostat's slot free).*/
 class HeatpumpBridge : public MUARTBridge{
   public:
   using MUARTBridge::MUARTBridge;
-  void loop() override;
+  void receivePackets() override;
+  void sendPackets() override;
+
+  // Whether a thermostat is connected, in which case a request slot is kept free for it
+  void set_reserve_thermostat_slot(bool reserve) { reserveThermostatSlot = reserve; };
+
+  protected:
+  SourceBridge sourceBridge() const override { return SourceBridge::heatpump; }
+  bool nextLane(QueueLane &lane);
+
+  bool reserveThermostatSlot = false;
 };
 
 class ThermostatBridge : public MUARTBridge{
   public:
   using MUARTBridge::MUARTBridge;
   //ThermostatBridge(uart::UARTComponent &uart_component, PacketProcessor &packet_processor) : MUARTBridge(uart_component, packet_processor){};
-  void loop() override;
+  void receivePackets() override;
+  void sendPackets() override;
+  protected:
+  SourceBridge sourceBridge() const override { return SourceBridge::thermostat; }
 };
 
 }  // namespace mitsubishi_uart
@@ -0,0 +1,72 @@
+#include "muart_capture.h"
+#include <cinttypes>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+void PacketCapture::record(const uint8_t *bytes, const uint8_t length, const SourceBridge source, const bool sent,
+                           const bool checksum_valid) {
+  CapturedFrame &frame = frames[(head + count) % CAPTURE_BUFFER_SIZE];
+  if (count < CAPTURE_BUFFER_SIZE) {
+    count++;
+  } else {
+    head = (head + 1) % CAPTURE_BUFFER_SIZE;
+  }
+
+  frame.timestampMillis = millis();
+  frame.source = source;
+  frame.flags = (sent ? CAPTURE_FLAG_SENT : 0) | (checksum_valid ? CAPTURE_FLAG_CHECKSUM_VALID : 0);
+  frame.length = std::min(length, PACKET_MAX_SIZE);
+  memcpy(frame.bytes, bytes, frame.length);
+  total++;
+}
+
+void PacketCapture::dump() const {
+  ESP_LOGI(CAPTURE_TAG, "Dumping %u of %" PRIu32 " captured frames", count, total);
+
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE];
+  // Two hex characters per byte, plus the null terminator
+  char hex[CAPTURE_RECORD_MAX_SIZE * 2 + 1];
+  static const char *HEX_DIGITS = "0123456789abcdef";
+
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t recordLength = serialize(at(i), record);
+    for (uint8_t b = 0; b < recordLength; b++) {
+      hex[b * 2] = HEX_DIGITS[record[b] >> 4];
+      hex[b * 2 + 1] = HEX_DIGITS[record[b] & 0x0F];
+    }
+    hex[recordLength * 2] = '\0';
+    ESP_LOGI(CAPTURE_TAG, "%s%s", CAPTURE_LOG_PREFIX, hex);
+  }
+}
+
+uint8_t PacketCapture::serialize(const CapturedFrame &frame, uint8_t *buffer) {
+  buffer[0] = frame.timestampMillis & 0xFF;
+  buffer[1] = (frame.timestampMillis >> 8) & 0xFF;
+  buffer[2] = (frame.timestampMillis >> 16) & 0xFF;
+  buffer[3] = (frame.timestampMillis >> 24) & 0xFF;
+  buffer[4] = static_cast<uint8_t>(frame.source);
+  buffer[5] = frame.flags;
+  buffer[6] = frame.length;
+  memcpy(buffer + CAPTURE_RECORD_HEADER_SIZE, frame.bytes, frame.length);
+  return CAPTURE_RECORD_HEADER_SIZE + frame.length;
+}
+
+size_t PacketCapture::deserialize(const uint8_t *data, const size_t length, CapturedFrame &frame) {
+  if (length < CAPTURE_RECORD_HEADER_SIZE) return 0;
+
+  // A frame needs at least a header and a checksum byte
+  const uint8_t frameLength = data[6];
+  if (frameLength < PACKET_HEADER_SIZE + 1 || frameLength > PACKET_MAX_SIZE) return 0;
+  if (length < (size_t) CAPTURE_RECORD_HEADER_SIZE + frameLength) return 0;
+
+  frame.timestampMillis = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+  frame.source = static_cast<SourceBridge>(data[4]);
+  frame.flags = data[5];
+  frame.length = frameLength;
+  memcpy(frame.bytes, data + CAPTURE_RECORD_HEADER_SIZE, frameLength);
+  return CAPTURE_RECORD_HEADER_SIZE + frameLength;
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "muart_rawpacket.h"
+#include <array>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+static const char *const CAPTURE_TAG = "mitsubishi_uart.capture";
+
+// Number of frames each bridge keeps in its capture buffer (about 30 bytes each)
+static const uint8_t CAPTURE_BUFFER_SIZE = 48;
+
+/* Capture export format (version 1)
+
+A capture file is CAPTURE_MAGIC followed by any number of records, oldest first.  Each record is:
+  uint32  timestamp    millis() when the frame was sent or received, little-endian
+  uint8   source       SourceBridge of the bridge that captured the frame (1 = heatpump, 2 = thermostat)
+  uint8   flags        CAPTURE_FLAG_* bits
+  uint8   length       Number of frame bytes that follow (at most PACKET_MAX_SIZE)
+  uint8[] frame        The raw frame, from the control byte through the checksum
+
+When exported over the log, each record is written as one line of hex prefixed with CAPTURE_LOG_PREFIX, so
+the file can be rebuilt by concatenating CAPTURE_MAGIC with the hex-decoded records in order.  Records from
+different bridges are exported separately; sort on timestamp to interleave them.*/
+static const uint8_t CAPTURE_MAGIC[] = {'M', 'U', 'C', 'A', 'P', 0x01};
+static const char *const CAPTURE_LOG_PREFIX = "MUCAP1 ";
+static const uint8_t CAPTURE_RECORD_HEADER_SIZE = 7;
+static const uint8_t CAPTURE_RECORD_MAX_SIZE = CAPTURE_RECORD_HEADER_SIZE + PACKET_MAX_SIZE;
+
+static const uint8_t CAPTURE_FLAG_SENT = 0x01;            // Frame was sent by the bridge (otherwise it was received)
+static const uint8_t CAPTURE_FLAG_CHECKSUM_VALID = 0x02;  // Frame's checksum was valid
+
+// A frame sent or received by a bridge
+struct CapturedFrame {
+  uint32_t timestampMillis;
+  SourceBridge source;
+  uint8_t flags;
+  uint8_t length;
+  uint8_t bytes[PACKET_MAX_SIZE];
+
+  bool isSent() const { return flags & CAPTURE_FLAG_SENT; }
+  bool isChecksumValid() const { return flags & CAPTURE_FLAG_CHECKSUM_VALID; }
+  // The frame as a packet, associated with the controller it would have been received for
+  RawPacket rawPacket() const {
+    return RawPacket(bytes, length, source,
+                     source == SourceBridge::thermostat ? ControllerAssociation::thermostat : ControllerAssociation::muart);
+  }
+};
+
+/* An always-on, fixed-size record of the most recent frames a bridge sent and received.  Recording a frame
+is just a copy into the ring buffer, so this can stay enabled in normal operation and be exported after
+something goes wrong.*/
+class PacketCapture {
+  public:
+    // Records a frame, overwriting the oldest one if the buffer is full
+    void record(const uint8_t *bytes, uint8_t length, SourceBridge source, bool sent, bool checksum_valid);
+
+    // Number of frames in the buffer
+    uint8_t size() const { return count; }
+    // Frame `index` in the buffer, where 0 is the oldest
+    const CapturedFrame &at(uint8_t index) const { return frames[(head + index) % CAPTURE_BUFFER_SIZE]; }
+    // Total frames recorded since boot, including ones that have since been overwritten
+    uint32_t totalRecorded() const { return total; }
+    void clear() { head = 0; count = 0; }
+
+    // Logs every frame in the buffer as export format records (see CAPTURE_LOG_PREFIX)
+    void dump() const;
+
+    // Writes `frame` as an export format record to `buffer` (which must hold CAPTURE_RECORD_MAX_SIZE bytes), returning its size
+    static uint8_t serialize(const CapturedFrame &frame, uint8_t *buffer);
+    /* Reads one export format record from `data` into `frame`.  Returns the number of bytes consumed, or 0 if `data`
+    doesn't hold a complete, valid record.*/
+    static size_t deserialize(const uint8_t *data, size_t length, CapturedFrame &frame);
+
+  private:
+    std::array<CapturedFrame, CAPTURE_BUFFER_SIZE> frames;
+    uint8_t head = 0;
+    uint8_t count = 0;
+    uint32_t total = 0;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
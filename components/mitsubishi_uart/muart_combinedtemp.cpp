@@ -0,0 +1,62 @@
+#include "muart_combinedtemp.h"
+#include <algorithm>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+void CombinedTemperatureSource::add_input(sensor::Sensor *sensor, const float weight) {
+  if (inputCount >= MAX_COMBINED_INPUTS) {
+    ESP_LOGW(TAG, "%s can combine at most %u sensors, ignoring %s", name.c_str(), MAX_COMBINED_INPUTS,
+             sensor->get_name().c_str());
+    return;
+  }
+
+  const uint8_t index = inputCount++;
+  inputs[index].weight = weight;
+  sensor->add_on_state_callback([this, index](float v) { inputReported(index, v); });
+}
+
+void CombinedTemperatureSource::inputReported(const uint8_t index, const float temperature) {
+  if (std::isnan(temperature)) return;
+
+  const uint32_t now = millis();
+  inputs[index].temperature = temperature;
+  inputs[index].receivedMillis = now;
+
+  const float combined = combine(now);
+  if (!std::isnan(combined)) parent_->temperature_source_report(name, combined);
+}
+
+float CombinedTemperatureSource::combine(const uint32_t now) const {
+  std::array<float, MAX_COMBINED_INPUTS> fresh;
+  uint8_t freshCount = 0;
+  float weightedSum = 0;
+  float totalWeight = 0;
+
+  for (uint8_t i = 0; i < inputCount; i++) {
+    const Input &input = inputs[i];
+    if (std::isnan(input.temperature) || now - input.receivedMillis > maxAgeMs) continue;
+    fresh[freshCount++] = input.temperature;
+    weightedSum += input.weight * input.temperature;
+    totalWeight += input.weight;
+  }
+  if (freshCount == 0) return NAN;
+
+  switch (method) {
+    case CombineMethod::minimum:
+      return *std::min_element(fresh.begin(), fresh.begin() + freshCount);
+    case CombineMethod::maximum:
+      return *std::max_element(fresh.begin(), fresh.begin() + freshCount);
+    case CombineMethod::median: {
+      std::sort(fresh.begin(), fresh.begin() + freshCount);
+      const uint8_t middle = freshCount / 2;
+      return freshCount % 2 ? fresh[middle] : (fresh[middle - 1] + fresh[middle]) / 2;
+    }
+    case CombineMethod::mean:
+    default:
+      return totalWeight > 0 ? weightedSum / totalWeight : NAN;
+  }
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
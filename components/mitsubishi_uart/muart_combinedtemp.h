@@ -0,0 +1,52 @@
+#pragma once
+
+#include "esphome/components/sensor/sensor.h"
+#include "mitsubishi_uart.h"
+#include <string>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Most sensors one CombinedTemperatureSource can combine
+static const uint8_t MAX_COMBINED_INPUTS = 8;
+
+// How a CombinedTemperatureSource combines its sensors' readings
+enum class CombineMethod : uint8_t {
+  mean,     // Weighted mean
+  minimum,
+  maximum,
+  median,
+};
+
+/* A virtual temperature source combining several sensors (e.g. spread around a large room) into one reading.  The
+combined value is recalculated whenever one of its sensors reports, and reported to the parent under this source's
+name, just like a single sensor.  Readings older than `max_age_ms` are left out; if none are left, nothing is
+reported, so the source goes stale like any other.*/
+class CombinedTemperatureSource : public Parented<MitsubishiUART> {
+  public:
+    CombinedTemperatureSource(std::string name, CombineMethod method, uint32_t max_age_ms)
+        : name{std::move(name)}, method{method}, maxAgeMs{max_age_ms} {}
+
+    // Adds a sensor to combine (`weight` only applies to CombineMethod::mean)
+    void add_input(sensor::Sensor *sensor, float weight);
+
+  private:
+    struct Input {
+      float weight;
+      float temperature = NAN;
+      uint32_t receivedMillis = 0;
+    };
+
+    void inputReported(uint8_t index, float temperature);
+    // The combined value of every fresh input, or NAN if there are none
+    float combine(uint32_t now) const;
+
+    std::string name;
+    CombineMethod method;
+    uint32_t maxAgeMs;
+    std::array<Input, MAX_COMBINED_INPUTS> inputs{};
+    uint8_t inputCount = 0;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,48 @@
+#include "muart_coordinator.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+uint8_t PollCoordinator::registerUnit() {
+  if (units >= MAX_COORDINATED_UNITS) {
+    ESP_LOGW(COORDINATOR_TAG, "More than %u units configured; the rest will poll uncoordinated", MAX_COORDINATED_UNITS);
+  }
+  return units++;
+}
+
+bool PollCoordinator::claimSlot(const uint8_t unit) {
+  if (units <= 1 || unit >= MAX_COORDINATED_UNITS) return true;
+
+  const uint32_t now = millis();
+  Claim &claim = claims[unit];
+  if (!claim.active) {
+    claim.active = true;
+    claim.sinceMillis = now;
+  }
+  claim.renewedMillis = now;
+
+  if (anyGranted && now - lastGrantMillis < lastGrantSpacingMs) return false;
+
+  // Wait for any unit that's been waiting longer (ties go to the lower index)
+  for (uint8_t other = 0; other < units && other < MAX_COORDINATED_UNITS; other++) {
+    Claim &otherClaim = claims[other];
+    if (other == unit || !otherClaim.active) continue;
+    if (now - otherClaim.renewedMillis > POLL_CLAIM_EXPIRY_MS) {
+      otherClaim.active = false;
+      continue;
+    }
+    const int32_t age = (int32_t) (claim.sinceMillis - otherClaim.sinceMillis);
+    if (age > 0 || (age == 0 && other < unit)) return false;
+  }
+
+  claim.active = false;
+  lastGrantMillis = now;
+  lastGrantSpacingMs = claim.spacingMs;
+  anyGranted = true;
+  return true;
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
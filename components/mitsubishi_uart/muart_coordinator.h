@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+static const char *const COORDINATOR_TAG = "mitsubishi_uart.coordinator";
+
+// Most units a PollCoordinator arbitrates between (any beyond this poll uncoordinated)
+static const uint8_t MAX_COORDINATED_UNITS = 8;
+// Default time after a unit's poll before another unit may poll
+static const uint32_t DEFAULT_POLL_SPACING_MS = 100;
+// A unit's claim is dropped if it isn't renewed for this long (e.g. it disconnected while waiting)
+static const uint32_t POLL_CLAIM_EXPIRY_MS = 1000;
+
+/* Shares poll timing between every MitsubishiUART on the device, so several indoor units driven by one controller
+take turns instead of all polling (and processing responses) in the same loop.  A unit claims a slot whenever it has
+a poll due; slots go to the oldest claim first, so no unit can starve the others.  After each grant, the other units
+wait for the granted unit's own poll spacing, so every unit keeps the spacing it was configured with.
+With a single unit every claim is granted straight away.*/
+class PollCoordinator {
+  public:
+    // The coordinator shared by every unit
+    static PollCoordinator &instance() {
+      static PollCoordinator INSTANCE;
+      return INSTANCE;
+    }
+
+    // Adds a unit, returning the index it should claim slots with
+    uint8_t registerUnit();
+    uint8_t unitCount() const { return units; }
+
+    // Time after `unit`'s polls before another unit may poll
+    void set_poll_spacing(uint8_t unit, uint32_t spacing_ms) {
+      if (unit < MAX_COORDINATED_UNITS) claims[unit].spacingMs = spacing_ms;
+    }
+
+    // Called by a unit each time it has a poll due; returns true if it may send it now
+    bool claimSlot(uint8_t unit);
+
+  private:
+    struct Claim {
+      bool active = false;
+      uint32_t sinceMillis = 0;    // When the unit started waiting
+      uint32_t renewedMillis = 0;  // When the unit last asked
+      uint32_t spacingMs = DEFAULT_POLL_SPACING_MS;
+    };
+
+    Claim claims[MAX_COORDINATED_UNITS];
+    uint8_t units = 0;
+    uint32_t lastGrantMillis = 0;
+    uint32_t lastGrantSpacingMs = 0;  // Spacing of the unit last granted a slot
+    bool anyGranted = false;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,82 @@
+#include "muart_looptiming.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include <algorithm>
+#include <cinttypes>
+#include <iterator>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+static const char *LOOP_STAGE_NAMES[LOOP_STAGE_COUNT] = {"loop",          "heatpump_receive", "thermostat_receive",
+                                                         "heatpump_send", "thermostat_send",  "packet_handler",
+                                                         "publish"};
+
+void StageTiming::record(const uint32_t micros_taken) {
+  // Index of the highest set bit, so 0-1us is bucket 0, 2-3us is bucket 1, 4-7us is bucket 2...
+  uint8_t bucket = 0;
+  for (uint32_t remaining = micros_taken >> 1; remaining > 0 && bucket < TIMING_BUCKET_COUNT - 1; remaining >>= 1) {
+    bucket++;
+  }
+  if (buckets[bucket] < UINT16_MAX) buckets[bucket]++;
+  maxMicros = std::max(maxMicros, micros_taken);
+  count++;
+}
+
+uint32_t StageTiming::percentile(const uint8_t percent) const {
+  if (count == 0) return 0;
+
+  const uint32_t rank = (count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t bucket = 0; bucket < TIMING_BUCKET_COUNT; bucket++) {
+    seen += buckets[bucket];
+    if (seen >= rank) return std::min<uint32_t>(1u << (bucket + 1), maxMicros);
+  }
+  return maxMicros;
+}
+
+void StageTiming::reset() {
+  maxMicros = 0;
+  count = 0;
+  std::fill(std::begin(buckets), std::end(buckets), 0);
+}
+
+void LoopMonitor::startLoop() {
+  if (budgetMicros > 0) loopStartMicros = micros();
+}
+
+bool LoopMonitor::budgetExhausted() const {
+  return budgetMicros > 0 && micros() - loopStartMicros >= budgetMicros;
+}
+
+void LoopMonitor::record(const LoopStage stage, const uint32_t micros_taken) {
+  stages[static_cast<uint8_t>(stage)].record(micros_taken);
+}
+
+void LoopMonitor::report() {
+  if (timingEnabled) {
+    for (uint8_t i = 0; i < LOOP_STAGE_COUNT; i++) {
+      StageTiming &timing = stages[i];
+      if (timing.count == 0) continue;
+      ESP_LOGD(TIMING_TAG, "%s: n=%" PRIu32 " max=%" PRIu32 "us p50<=%" PRIu32 "us p95<=%" PRIu32 "us p99<=%" PRIu32 "us", LOOP_STAGE_NAMES[i], timing.count,
+               timing.maxMicros, timing.percentile(50), timing.percentile(95), timing.percentile(99));
+      timing.reset();
+    }
+  }
+  if (yields > 0) {
+    ESP_LOGD(TIMING_TAG, "Yielded %" PRIu32 " times to stay within the %" PRIu32 "us loop budget", yields, budgetMicros);
+    yields = 0;
+  }
+}
+
+LoopMonitor::Scope::Scope(LoopMonitor *monitor, const LoopStage stage)
+    : monitor{monitor != nullptr && monitor->timingEnabled ? monitor : nullptr}, stage{stage} {
+  if (this->monitor) startMicros = micros();
+}
+
+LoopMonitor::Scope::~Scope() {
+  if (monitor) monitor->record(stage, micros() - startMicros);
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
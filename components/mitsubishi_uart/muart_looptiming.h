@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+static const char *const TIMING_TAG = "mitsubishi_uart.timing";
+
+// Parts of the component's work that are timed separately
+enum class LoopStage : uint8_t {
+  loop,                // All of MitsubishiUART::loop()
+  heatpump_receive,    // HeatpumpBridge::receivePackets()
+  thermostat_receive,  // ThermostatBridge::receivePackets()
+  heatpump_send,       // HeatpumpBridge::sendPackets()
+  thermostat_send,     // ThermostatBridge::sendPackets()
+  packet_handler,      // Each packet's PacketProcessor handler
+  publish,             // MitsubishiUART::doPublish()
+};
+static const uint8_t LOOP_STAGE_COUNT = 7;
+
+// Timings are kept in power-of-two buckets of microseconds: bucket n holds times under 2^(n+1)us
+static const uint8_t TIMING_BUCKET_COUNT = 20;
+
+// Distribution of the time spent in one LoopStage since the last report
+struct StageTiming {
+  uint32_t maxMicros = 0;
+  uint32_t count = 0;
+  uint16_t buckets[TIMING_BUCKET_COUNT]{};
+
+  void record(uint32_t micros_taken);
+  // Upper bound (us) of the bucket containing the `percent`th percentile
+  uint32_t percentile(uint8_t percent) const;
+  void reset();
+};
+
+/* Measures how long the component spends in each LoopStage, and enforces an optional time budget per call
+to loop().  Once the budget is used up, the bridges stop taking on more packets and loop() skips its
+remaining work, picking it back up on the next iteration (received bytes wait in the UART's buffer).*/
+class LoopMonitor {
+  public:
+    // Maximum time (us) to spend in one call to loop() before yielding (0 for no limit)
+    void set_budget(uint32_t budget_us) { budgetMicros = budget_us; };
+    // Whether stage timings are recorded (the budget is enforced either way)
+    void set_timing_enabled(bool enabled) { timingEnabled = enabled; };
+    bool isTimingEnabled() const { return timingEnabled; };
+
+    // Marks the start of a call to loop(), for the budget
+    void startLoop();
+    // Has this call to loop() used up its budget
+    bool budgetExhausted() const;
+    // Counts a call to loop() that stopped early because of the budget
+    void noteYield() { yields++; };
+
+    void record(LoopStage stage, uint32_t micros_taken);
+    // Logs the timings since the last report, then resets them
+    void report();
+
+    // Times a LoopStage for as long as it's in scope (does nothing if `monitor` is null or timing is disabled)
+    class Scope {
+      public:
+        Scope(LoopMonitor *monitor, LoopStage stage);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        LoopMonitor *monitor;
+        LoopStage stage;
+        uint32_t startMicros;
+    };
+
+  private:
+    StageTiming stages[LOOP_STAGE_COUNT];
+    uint32_t budgetMicros = 0;
+    uint32_t loopStartMicros = 0;
+    uint32_t yields = 0;
+    bool timingEnabled = false;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
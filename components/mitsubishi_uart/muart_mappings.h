@@ -0,0 +1,112 @@
+#pragma once
+
+#include "esphome/components/climate/climate.h"
+#include "muart_packet.h"
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+/* Mappings between the bytes the heat pump uses for a setting and how that setting is shown in ESPHome.  Each
+table is used both to decode responses and to encode requests, so the two directions can't disagree.  Select
+options are built from the tables in the same order, so an option's index is also its index in the table.*/
+template<typename Byte, typename Value> struct SettingMapping {
+  Byte byte;
+  Value value;
+};
+
+using ModeMapping = SettingMapping<SettingsSetRequestPacket::MODE_BYTE, climate::ClimateMode>;
+using FanMapping = SettingMapping<SettingsSetRequestPacket::FAN_BYTE, climate::ClimateFanMode>;
+using CustomFanMapping = SettingMapping<SettingsSetRequestPacket::FAN_BYTE, const char *>;
+using VaneMapping = SettingMapping<SettingsSetRequestPacket::VANE_BYTE, const char *>;
+using HorizontalVaneMapping = SettingMapping<SettingsSetRequestPacket::HORIZONTAL_VANE_BYTE, const char *>;
+
+// Modes while powered on (powered off is always CLIMATE_MODE_OFF)
+static constexpr ModeMapping MODE_MAPPINGS[] = {
+    {SettingsSetRequestPacket::MODE_BYTE_HEAT, climate::CLIMATE_MODE_HEAT},
+    {SettingsSetRequestPacket::MODE_BYTE_DRY, climate::CLIMATE_MODE_DRY},
+    {SettingsSetRequestPacket::MODE_BYTE_COOL, climate::CLIMATE_MODE_COOL},
+    {SettingsSetRequestPacket::MODE_BYTE_FAN, climate::CLIMATE_MODE_FAN_ONLY},
+    {SettingsSetRequestPacket::MODE_BYTE_AUTO, climate::CLIMATE_MODE_HEAT_COOL},
+};
+
+static constexpr FanMapping FAN_MAPPINGS[] = {
+    {SettingsSetRequestPacket::FAN_AUTO, climate::CLIMATE_FAN_AUTO},
+    {SettingsSetRequestPacket::FAN_QUIET, climate::CLIMATE_FAN_QUIET},
+    {SettingsSetRequestPacket::FAN_1, climate::CLIMATE_FAN_LOW},
+    {SettingsSetRequestPacket::FAN_2, climate::CLIMATE_FAN_MEDIUM},
+    {SettingsSetRequestPacket::FAN_3, climate::CLIMATE_FAN_HIGH},
+};
+
+// Fan speeds without a matching ClimateFanMode, shown as custom fan modes
+static constexpr const char *CUSTOM_FAN_VERYHIGH = "Very High";
+static constexpr CustomFanMapping CUSTOM_FAN_MAPPINGS[] = {
+    {SettingsSetRequestPacket::FAN_4, CUSTOM_FAN_VERYHIGH},
+};
+
+static constexpr VaneMapping VANE_MAPPINGS[] = {
+    {SettingsSetRequestPacket::VANE_AUTO, "Auto"}, {SettingsSetRequestPacket::VANE_1, "1"},
+    {SettingsSetRequestPacket::VANE_2, "2"},       {SettingsSetRequestPacket::VANE_3, "3"},
+    {SettingsSetRequestPacket::VANE_4, "4"},       {SettingsSetRequestPacket::VANE_5, "5"},
+    {SettingsSetRequestPacket::VANE_SWING, "Swing"},
+};
+
+static constexpr HorizontalVaneMapping HORIZONTAL_VANE_MAPPINGS[] = {
+    {SettingsSetRequestPacket::HV_AUTO, "Auto"},  {SettingsSetRequestPacket::HV_LEFT_FULL, "<<"},
+    {SettingsSetRequestPacket::HV_LEFT, "<"},     {SettingsSetRequestPacket::HV_CENTER, "|"},
+    {SettingsSetRequestPacket::HV_RIGHT, ">"},    {SettingsSetRequestPacket::HV_RIGHT_FULL, ">>"},
+    {SettingsSetRequestPacket::HV_SPLIT, "<>"},   {SettingsSetRequestPacket::HV_SWING, "Swing"},
+};
+
+// The select options in __init__.py (VANE_POSITIONS, HORIZONTAL_VANE_POSITIONS) list these names in this order;
+// change them together
+static_assert(sizeof(VANE_MAPPINGS) / sizeof(VANE_MAPPINGS[0]) == 7, "VANE_POSITIONS in __init__.py has 7 options");
+static_assert(sizeof(HORIZONTAL_VANE_MAPPINGS) / sizeof(HORIZONTAL_VANE_MAPPINGS[0]) == 8,
+              "HORIZONTAL_VANE_POSITIONS in __init__.py has 8 options");
+
+// The mapping for `byte` in `table`, or nullptr if there isn't one
+template<typename Byte, typename Value, size_t N>
+const SettingMapping<Byte, Value> *mappingForByte(const SettingMapping<Byte, Value> (&table)[N], const uint8_t byte) {
+  for (const SettingMapping<Byte, Value> &mapping : table) {
+    if (mapping.byte == byte) return &mapping;
+  }
+  return nullptr;
+}
+
+// The mapping for `value` in `table`, or nullptr if there isn't one
+template<typename Byte, typename Value, size_t N>
+const SettingMapping<Byte, Value> *mappingForValue(const SettingMapping<Byte, Value> (&table)[N], const Value value) {
+  for (const SettingMapping<Byte, Value> &mapping : table) {
+    if (mapping.value == value) return &mapping;
+  }
+  return nullptr;
+}
+
+// As above, for tables of names
+template<typename Byte, size_t N>
+const SettingMapping<Byte, const char *> *mappingForValue(const SettingMapping<Byte, const char *> (&table)[N],
+                                                          const std::string &value) {
+  for (const SettingMapping<Byte, const char *> &mapping : table) {
+    if (value == mapping.value) return &mapping;
+  }
+  return nullptr;
+}
+
+// The mapping at `index` in `table` (e.g. a select option's index, see mappingNames), or nullptr if there isn't one
+template<typename Byte, typename Value, size_t N>
+const SettingMapping<Byte, Value> *mappingAt(const SettingMapping<Byte, Value> (&table)[N], const size_t index) {
+  return index < N ? &table[index] : nullptr;
+}
+
+// The names in a table of names, in order, for use as select options
+template<typename Byte, size_t N>
+std::vector<std::string> mappingNames(const SettingMapping<Byte, const char *> (&table)[N]) {
+  std::vector<std::string> names;
+  names.reserve(N);
+  for (const SettingMapping<Byte, const char *> &mapping : table) names.emplace_back(mapping.value);
+  return names;
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
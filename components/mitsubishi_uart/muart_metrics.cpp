@@ -0,0 +1,77 @@
+#include "muart_metrics.h"
+#include "esphome/core/hal.h"
+#include <algorithm>
+#include <iterator>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+void BridgeMetrics::recordQueueDepth(const uint8_t depth) {
+  maxQueueDepth = std::max(maxQueueDepth, depth);
+  queueDepthSum += depth;
+  queueDepthSamples++;
+}
+
+void BridgeMetrics::recordRoundTrip(const uint32_t round_trip_ms) {
+  const uint32_t bucket = std::min(round_trip_ms / ROUND_TRIP_BUCKET_MS, (uint32_t) ROUND_TRIP_BUCKET_COUNT - 1);
+  if (roundTripBuckets[bucket] < UINT16_MAX) roundTripBuckets[bucket]++;
+  roundTripSamples++;
+}
+
+float BridgeMetrics::value(const BridgeMetric metric, const uint32_t baud_rate) const {
+  switch (metric) {
+    case BridgeMetric::frames_received:
+      return framesReceived;
+    case BridgeMetric::frames_sent:
+      return framesSent;
+    case BridgeMetric::checksum_failures:
+      return checksumFailures;
+    case BridgeMetric::resyncs:
+      return resyncs;
+    case BridgeMetric::response_timeouts:
+      return responseTimeouts;
+    case BridgeMetric::queue_full_drops:
+      return queueFullDrops;
+    case BridgeMetric::max_queue_depth:
+      return maxQueueDepth;
+    case BridgeMetric::average_queue_depth:
+      return queueDepthSamples > 0 ? (float) queueDepthSum / queueDepthSamples : 0.0f;
+    case BridgeMetric::round_trip_p50:
+      return roundTripPercentile(50);
+    case BridgeMetric::round_trip_p95:
+      return roundTripPercentile(95);
+    case BridgeMetric::link_utilization: {
+      const uint32_t elapsedMillis = millis() - windowStartMillis;
+      if (elapsedMillis == 0 || baud_rate == 0) return NAN;
+      const float capacityBytes = (float) baud_rate / UART_BITS_PER_BYTE * elapsedMillis / 1000.0f;
+      return 100.0f * windowBytes / capacityBytes;
+    }
+  }
+  return NAN;
+}
+
+float BridgeMetrics::roundTripPercentile(const uint8_t percent) const {
+  if (roundTripSamples == 0) return NAN;
+
+  // Rank of the sample we're looking for, rounded up
+  const uint32_t rank = (roundTripSamples * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t bucket = 0; bucket < ROUND_TRIP_BUCKET_COUNT; bucket++) {
+    seen += roundTripBuckets[bucket];
+    if (seen >= rank) return (bucket + 1) * ROUND_TRIP_BUCKET_MS;
+  }
+  return ROUND_TRIP_BUCKET_COUNT * ROUND_TRIP_BUCKET_MS;
+}
+
+void BridgeMetrics::resetWindow() {
+  maxQueueDepth = 0;
+  queueDepthSum = 0;
+  queueDepthSamples = 0;
+  std::fill(std::begin(roundTripBuckets), std::end(roundTripBuckets), 0);
+  roundTripSamples = 0;
+  windowBytes = 0;
+  windowStartMillis = millis();
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
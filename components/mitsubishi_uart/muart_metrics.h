@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Values reported by BridgeMetrics, in the order they're published
+enum class BridgeMetric : uint8_t {
+  frames_received,      // Total frames received
+  frames_sent,          // Total frames sent
+  checksum_failures,    // Total received frames with an invalid checksum
+  resyncs,              // Total times the frame parser lost sync and discarded data
+  response_timeouts,    // Total requests that timed out waiting for a response (including ones later retried)
+  queue_full_drops,     // Total packets dropped because the send queue was full
+  max_queue_depth,      // Deepest the send queue got during the window
+  average_queue_depth,  // Average send queue depth after each packet was queued during the window
+  round_trip_p50,       // Median request round-trip time during the window (ms)
+  round_trip_p95,       // 95th percentile request round-trip time during the window (ms)
+  link_utilization,     // Share of the link's capacity used (both directions) during the window (%)
+};
+static const uint8_t BRIDGE_METRIC_COUNT = 11;
+
+// Round-trip times are kept in a histogram of this many buckets of this width; anything slower goes in the last
+static const uint32_t ROUND_TRIP_BUCKET_MS = 50;
+static const uint8_t ROUND_TRIP_BUCKET_COUNT = 64;
+// Bits on the wire per byte: start bit, 8 data bits, parity, stop bit
+static const uint8_t UART_BITS_PER_BYTE = 11;
+
+/* Bus health counters for a single bridge.  Totals count since boot; the other metrics cover the window
+since resetWindow() was last called.  Recording is just arithmetic on fixed fields, so it's always on.*/
+struct BridgeMetrics {
+  uint32_t framesReceived = 0;
+  uint32_t framesSent = 0;
+  uint32_t checksumFailures = 0;
+  uint32_t resyncs = 0;
+  uint32_t responseTimeouts = 0;
+  uint32_t queueFullDrops = 0;
+
+  uint8_t maxQueueDepth = 0;
+  uint32_t queueDepthSum = 0;
+  uint32_t queueDepthSamples = 0;
+  uint16_t roundTripBuckets[ROUND_TRIP_BUCKET_COUNT]{};
+  uint32_t roundTripSamples = 0;
+  uint32_t windowBytes = 0;
+  uint32_t windowStartMillis = 0;
+
+  void recordQueueDepth(uint8_t depth);
+  void recordRoundTrip(uint32_t round_trip_ms);
+  void recordBytes(uint8_t count) { windowBytes += count; };
+
+  // Returns the current value of `metric` (NAN if there's nothing to report for the window)
+  float value(BridgeMetric metric, uint32_t baud_rate) const;
+  // Starts a new window for the windowed metrics
+  void resetWindow();
+
+  private:
+    // Upper bound (ms) of the bucket containing the `percent`th percentile round trip
+    float roundTripPercentile(uint8_t percent) const;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -1,97 +1,78 @@
 #include "muart_packet.h"
 #include "muart_utils.h"
-#include "mitsubishi_uart.h"
 
 namespace esphome {
 namespace mitsubishi_uart {
 
-// Packet to_strings()
+// Packet formatDetailed()s
 
-std::string ConnectRequestPacket::to_string() const {
-  return("Connect Request: " + Packet::to_string());
+static const char *yes_no(const bool value) { return value ? "Yes" : "No"; }
+
+size_t ConnectRequestPacket::formatDetailed(char *buffer, size_t size) const {
+  return formatNamed(buffer, size, "Connect Request");
 }
-std::string ConnectResponsePacket::to_string() const {
-  return("Connect Response: " + Packet::to_string());
+size_t ConnectResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  return formatNamed(buffer, size, "Connect Response");
 }
-std::string ExtendedConnectResponsePacket::to_string() const {
-  return ("Extended Connect Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n HeatDisabled:" + (isHeatDisabled()?"Yes":"No")
-  + " SupportsVane:" + (supportsVane()?"Yes":"No")
-  + " SupportsVaneSwing:" + (supportsVaneSwing()?"Yes":"No")
-
-  + " DryDisabled:" + (isDryDisabled()?"Yes":"No")
-  + " FanDisabled:" + (isFanDisabled()?"Yes":"No")
-  + " ExtTempRange:" + (hasExtendedTemperatureRange()?"Yes":"No")
-  + " AutoFanDisabled:" + (autoFanSpeedDisabled()?"Yes":"No")
-  + " InstallerSettings:" + (supportsInstallerSettings()?"Yes":"No")
-  + " TestMode:" + (supportsTestMode()?"Yes":"No")
-  + " DryTemp:" + (supportsDryTemperature()?"Yes":"No")
-
-  + " StatusDisplay:" + (hasStatusDisplay()?"Yes":"No")
-
-  + "\n CoolDrySetpoint:" + std::to_string(getMinCoolDrySetpoint()) + "/" + std::to_string(getMaxCoolDrySetpoint())
-  + " HeatSetpoint:" + std::to_string(getMinHeatingSetpoint()) + "/" + std::to_string(getMaxHeatingSetpoint())
-  + " AutoSetpoint:" + std::to_string(getMinAutoSetpoint()) + "/" + std::to_string(getMaxAutoSetpoint())
-  + " FanSpeeds:" + std::to_string(getSupportedFanSpeeds()));
+size_t ExtendedConnectResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Extended Connect Response");
+  pos = appendf(buffer, size, pos,
+                "%s\n HeatDisabled:%s SupportsVane:%s SupportsVaneSwing:%s"
+                " DryDisabled:%s FanDisabled:%s ExtTempRange:%s AutoFanDisabled:%s InstallerSettings:%s TestMode:%s"
+                " DryTemp:%s StatusDisplay:%s",
+                CONSOLE_COLOR_PURPLE, yes_no(isHeatDisabled()), yes_no(supportsVane()), yes_no(supportsVaneSwing()),
+                yes_no(isDryDisabled()), yes_no(isFanDisabled()), yes_no(hasExtendedTemperatureRange()),
+                yes_no(autoFanSpeedDisabled()), yes_no(supportsInstallerSettings()), yes_no(supportsTestMode()),
+                yes_no(supportsDryTemperature()), yes_no(hasStatusDisplay()));
+  return appendf(buffer, size, pos, "\n CoolDrySetpoint:%.1f/%.1f HeatSetpoint:%.1f/%.1f AutoSetpoint:%.1f/%.1f FanSpeeds:%u",
+                 getMinCoolDrySetpoint(), getMaxCoolDrySetpoint(), getMinHeatingSetpoint(), getMaxHeatingSetpoint(),
+                 getMinAutoSetpoint(), getMaxAutoSetpoint(), getSupportedFanSpeeds());
 }
-std::string CurrentTempGetResponsePacket::to_string() const {
-  return ("Current Temp Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n Temp:" + std::to_string(getCurrentTemp()));
+size_t CurrentTempGetResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Current Temp Response");
+  return appendf(buffer, size, pos, "%s\n Temp:%.1f", CONSOLE_COLOR_PURPLE, getCurrentTemp());
 }
-std::string SettingsGetResponsePacket::to_string() const {
-
-  return ("Settings Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n Fan:" + format_hex(getFan())
-  + " Mode:" + format_hex(getMode())
-  + " Power:" + (getPower()==3 ? "Test" : getPower()>0 ? "On" : "Off")
-  + " TargetTemp:" + std::to_string(getTargetTemp())
-  + " Vane:" + format_hex(getVane())
-  + " HVane:" + format_hex(getHorizontalVane()) + (getHorizontalVaneMSB() ? " (MSB Set)" : "")
-  + "\n PowerLock:" + (lockedPower()?"Yes":"No")
-  + " ModeLock:" + (lockedMode()?"Yes":"No")
-  + " TempLock:" + (lockedTemp()?"Yes":"No")
-  );
+size_t SettingsGetResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Settings Response");
+  return appendf(buffer, size, pos,
+                 "%s\n Fan:%02x Mode:%02x Power:%s TargetTemp:%.1f Vane:%02x HVane:%02x%s"
+                 "\n PowerLock:%s ModeLock:%s TempLock:%s",
+                 CONSOLE_COLOR_PURPLE, getFan(), getMode(), getPower() == 3 ? "Test" : getPower() > 0 ? "On" : "Off",
+                 getTargetTemp(), getVane(), getHorizontalVane(), getHorizontalVaneMSB() ? " (MSB Set)" : "",
+                 yes_no(lockedPower()), yes_no(lockedMode()), yes_no(lockedTemp()));
 }
-std::string StandbyGetResponsePacket::to_string() const {
-  return ("Standby Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n ServiceFilter:" + (serviceFilter()?"Yes":"No")
-  + " Defrost:" + (inDefrost()?"Yes":"No")
-  + " HotAdjust:" + (inHotAdjust()?"Yes":"No")
-  + " Standby:" + (inStandby()?"Yes":"No")
-  + " ActualFan:" + ACTUAL_FAN_SPEED_NAMES[getActualFanSpeed()] + " (" + std::to_string(getActualFanSpeed()) + ")"
-  + " AutoMode:" + format_hex(getAutoMode())
-  );
+size_t StandbyGetResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Standby Response");
+  return appendf(buffer, size, pos,
+                 "%s\n ServiceFilter:%s Defrost:%s HotAdjust:%s Standby:%s ActualFan:%s (%u) AutoMode:%02x",
+                 CONSOLE_COLOR_PURPLE, yes_no(serviceFilter()), yes_no(inDefrost()), yes_no(inHotAdjust()),
+                 yes_no(inStandby()),
+                 getActualFanSpeed() < ACTUAL_FAN_SPEED_NAMES.size() ? ACTUAL_FAN_SPEED_NAMES[getActualFanSpeed()].c_str() : "?",
+                 getActualFanSpeed(),
+                 getAutoMode());
 }
-std::string StatusGetResponsePacket::to_string() const {
-  return ("Status Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n CompressorFrequency: " + std::to_string(getCompressorFrequency())
-  + " Operating: " + (getOperating() ? "Yes":"No")
-  );
+size_t StatusGetResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Status Response");
+  return appendf(buffer, size, pos, "%s\n CompressorFrequency: %u Operating: %s", CONSOLE_COLOR_PURPLE,
+                 getCompressorFrequency(), yes_no(getOperating()));
 }
-std::string ErrorStateGetResponsePacket::to_string() const {
-  return ("Error State Response: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n Error State: " + (errorPresent() ? "Yes" : "No")
-  + " ErrorCode: " + format_hex(getErrorCode())
-  + " ShortCode: " + getShortCode() + "(" + format_hex(getRawShortCode()) + ")"
-  );
+size_t ErrorStateGetResponsePacket::formatDetailed(char *buffer, size_t size) const {
+  char shortCode[8];
+  getShortCode(shortCode);
+  size_t pos = formatNamed(buffer, size, "Error State Response");
+  return appendf(buffer, size, pos, "%s\n Error State: %s ErrorCode: %04x ShortCode: %s(%02x)", CONSOLE_COLOR_PURPLE,
+                 yes_no(errorPresent()), getErrorCode(), shortCode, getRawShortCode());
 }
-std::string RemoteTemperatureSetRequestPacket::to_string() const {
-  return ("Remote Temp Set Request: " + Packet::to_string()
-  + CONSOLE_COLOR_PURPLE
-  + "\n Temp:" + std::to_string(getRemoteTemperature()));
+size_t RemoteTemperatureSetRequestPacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Remote Temp Set Request");
+  return appendf(buffer, size, pos, "%s\n Temp:%.1f", CONSOLE_COLOR_PURPLE, getRemoteTemperature());
 }
 
-std::string ThermostatHelloRequestPacket::to_string() const {
-  return("Thermostat Hello: " + Packet::to_string() + CONSOLE_COLOR_PURPLE +
-          "\n Model: " + getThermostatModel() +
-          " Serial: " + getThermostatSerial() +
-          " Version: " + getThermostatVersionString());
+// Only sent once per connection, so the string-returning getters are fine here
+size_t ThermostatHelloRequestPacket::formatDetailed(char *buffer, size_t size) const {
+  size_t pos = formatNamed(buffer, size, "Thermostat Hello");
+  return appendf(buffer, size, pos, "%s\n Model: %s Serial: %s Version: %s", CONSOLE_COLOR_PURPLE,
+                 getThermostatModel().c_str(), getThermostatSerial().c_str(), getThermostatVersionString().c_str());
 }
 
 // TODO: Are there function implementations for packets in the .h file? (Yes)  Should they be here?
@@ -107,21 +88,21 @@ void SettingsSetRequestPacket::addSettingsFlag2(const SETTING_FLAG2 flag2ToAdd)
 }
 
 SettingsSetRequestPacket &SettingsSetRequestPacket::setPower(const bool isOn) {
-  pkt_.setPayloadByte(PLINDEX_POWER, isOn ? 0x01 : 0x00);
+  pkt_->setPayloadByte(PLINDEX_POWER, isOn ? 0x01 : 0x00);
   addSettingsFlag(SF_POWER);
   return *this;
 }
 
 SettingsSetRequestPacket &SettingsSetRequestPacket::setMode(const MODE_BYTE mode) {
-  pkt_.setPayloadByte(PLINDEX_MODE, mode);
+  pkt_->setPayloadByte(PLINDEX_MODE, mode);
   addSettingsFlag(SF_MODE);
   return *this;
 }
 
 SettingsSetRequestPacket &SettingsSetRequestPacket::setTargetTemperature(const float temperatureDegressC) {
   if (temperatureDegressC < 63.5 && temperatureDegressC > -64.0) {
-    pkt_.setPayloadByte(PLINDEX_TARGET_TEMPERATURE, MUARTUtils::DegCToTempScaleA(temperatureDegressC));
-    pkt_.setPayloadByte(PLINDEX_TARGET_TEMPERATURE_CODE, MUARTUtils::DegCToLegacyTargetTemp(temperatureDegressC));
+    pkt_->setPayloadByte(PLINDEX_TARGET_TEMPERATURE, MUARTUtils::DegCToTempScaleA(temperatureDegressC));
+    pkt_->setPayloadByte(PLINDEX_TARGET_TEMPERATURE_CODE, MUARTUtils::DegCToLegacyTargetTemp(temperatureDegressC));
 
     // TODO: while spawning a warning here is fine, we should (a) only actually send that warning if the system can't
     //       support this setpoint, and (b) clamp the setpoint to the known-acceptable values.
@@ -138,29 +119,48 @@ SettingsSetRequestPacket &SettingsSetRequestPacket::setTargetTemperature(const f
   return *this;
 }
 SettingsSetRequestPacket &SettingsSetRequestPacket::setFan(const FAN_BYTE fan) {
-  pkt_.setPayloadByte(PLINDEX_FAN, fan);
+  pkt_->setPayloadByte(PLINDEX_FAN, fan);
   addSettingsFlag(SF_FAN);
   return *this;
 }
 
 SettingsSetRequestPacket &SettingsSetRequestPacket::setVane(const VANE_BYTE vane) {
-  pkt_.setPayloadByte(PLINDEX_VANE, vane);
+  pkt_->setPayloadByte(PLINDEX_VANE, vane);
   addSettingsFlag(SF_VANE);
   return *this;
 }
 
 SettingsSetRequestPacket &SettingsSetRequestPacket::setHorizontalVane(const HORIZONTAL_VANE_BYTE horizontal_vane) {
-  pkt_.setPayloadByte(PLINDEX_HORIZONTAL_VANE, horizontal_vane);
+  pkt_->setPayloadByte(PLINDEX_HORIZONTAL_VANE, horizontal_vane);
   addSettingsFlag2(SF2_HORIZONTAL_VANE);
   return *this;
 }
 
+SettingsSetRequestPacket &SettingsSetRequestPacket::merge(const SettingsSetRequestPacket &newer) {
+  const uint8_t flags = newer.pkt_->getPayloadByte(PLINDEX_FLAGS);
+  const uint8_t flags2 = newer.pkt_->getPayloadByte(PLINDEX_FLAGS2);
+
+  if (flags & SF_POWER) pkt_->setPayloadByte(PLINDEX_POWER, newer.pkt_->getPayloadByte(PLINDEX_POWER));
+  if (flags & SF_MODE) pkt_->setPayloadByte(PLINDEX_MODE, newer.pkt_->getPayloadByte(PLINDEX_MODE));
+  if (flags & SF_TARGET_TEMPERATURE) {
+    pkt_->setPayloadByte(PLINDEX_TARGET_TEMPERATURE, newer.pkt_->getPayloadByte(PLINDEX_TARGET_TEMPERATURE));
+    pkt_->setPayloadByte(PLINDEX_TARGET_TEMPERATURE_CODE, newer.pkt_->getPayloadByte(PLINDEX_TARGET_TEMPERATURE_CODE));
+  }
+  if (flags & SF_FAN) pkt_->setPayloadByte(PLINDEX_FAN, newer.pkt_->getPayloadByte(PLINDEX_FAN));
+  if (flags & SF_VANE) pkt_->setPayloadByte(PLINDEX_VANE, newer.pkt_->getPayloadByte(PLINDEX_VANE));
+  if (flags2 & SF2_HORIZONTAL_VANE) pkt_->setPayloadByte(PLINDEX_HORIZONTAL_VANE, newer.pkt_->getPayloadByte(PLINDEX_HORIZONTAL_VANE));
+
+  addFlag(flags);
+  addFlag2(flags2);
+  return *this;
+}
+
 // SettingsGetResponsePacket functions
 float SettingsGetResponsePacket::getTargetTemp() const {
-  uint8_t enhancedRawTemp = pkt_.getPayloadByte(PLINDEX_TARGETTEMP);
+  uint8_t enhancedRawTemp = pkt_->getPayloadByte(PLINDEX_TARGETTEMP);
 
   if (enhancedRawTemp == 0x00) {
-    uint8_t legacyRawTemp = pkt_.getPayloadByte(PLINDEX_TARGETTEMP_LEGACY);
+    uint8_t legacyRawTemp = pkt_->getPayloadByte(PLINDEX_TARGETTEMP_LEGACY);
     return MUARTUtils::LegacyTargetTempToDegC(legacyRawTemp);
   }
 
@@ -171,10 +171,10 @@ float SettingsGetResponsePacket::getTargetTemp() const {
 // RemoteTemperatureSetRequestPacket functions
 
 float RemoteTemperatureSetRequestPacket::getRemoteTemperature() const {
-  uint8_t rawTempA = pkt_.getPayloadByte(PLINDEX_REMOTE_TEMPERATURE);
+  uint8_t rawTempA = pkt_->getPayloadByte(PLINDEX_REMOTE_TEMPERATURE);
 
   if (rawTempA == 0) {
-    uint8_t rawTempLegacy = pkt_.getPayloadByte(PLINDEX_LEGACY_REMOTE_TEMPERATURE);
+    uint8_t rawTempLegacy = pkt_->getPayloadByte(PLINDEX_LEGACY_REMOTE_TEMPERATURE);
     return MUARTUtils::LegacyRoomTempToDegC(rawTempLegacy);
   }
 
@@ -183,8 +183,8 @@ float RemoteTemperatureSetRequestPacket::getRemoteTemperature() const {
 
 RemoteTemperatureSetRequestPacket &RemoteTemperatureSetRequestPacket::setRemoteTemperature(float temperatureDegressC) {
   if (temperatureDegressC < 63.5 && temperatureDegressC > -64.0) {
-    pkt_.setPayloadByte(PLINDEX_REMOTE_TEMPERATURE, MUARTUtils::DegCToTempScaleA(temperatureDegressC));
-    pkt_.setPayloadByte(PLINDEX_LEGACY_REMOTE_TEMPERATURE, MUARTUtils::DegCToLegacyRoomTemp(temperatureDegressC));
+    pkt_->setPayloadByte(PLINDEX_REMOTE_TEMPERATURE, MUARTUtils::DegCToTempScaleA(temperatureDegressC));
+    pkt_->setPayloadByte(PLINDEX_LEGACY_REMOTE_TEMPERATURE, MUARTUtils::DegCToLegacyRoomTemp(temperatureDegressC));
     setFlags(0x01); // Set flags to say we're providing the temperature
   } else {
     ESP_LOGW(PTAG, "Remote temp %f is outside valid range.", temperatureDegressC);
@@ -198,11 +198,11 @@ RemoteTemperatureSetRequestPacket &RemoteTemperatureSetRequestPacket::useInterna
 
 // CurrentTempGetResponsePacket functions
 float CurrentTempGetResponsePacket::getCurrentTemp() const {
-  uint8_t enhancedRawTemp = pkt_.getPayloadByte(PLINDEX_CURRENTTEMP);
+  uint8_t enhancedRawTemp = pkt_->getPayloadByte(PLINDEX_CURRENTTEMP);
 
   //TODO: Figure out how to handle "out of range" issues here.
   if (enhancedRawTemp == 0) {
-    uint8_t legacyRawTemp = pkt_.getPayloadByte(PLINDEX_CURRENTTEMP_LEGACY);
+    uint8_t legacyRawTemp = pkt_->getPayloadByte(PLINDEX_CURRENTTEMP_LEGACY);
     return MUARTUtils::LegacyRoomTempToDegC(legacyRawTemp);
   }
 
@@ -211,43 +211,50 @@ float CurrentTempGetResponsePacket::getCurrentTemp() const {
 
 // ThermostatHelloRequestPacket functions
 std::string ThermostatHelloRequestPacket::getThermostatModel() const {
-  return MUARTUtils::DecodeNBitString((pkt_.getBytes() + 1), 3, 6);
+  return MUARTUtils::DecodeNBitString((pkt_->getBytes() + 1), 3, 6);
 }
 
 std::string ThermostatHelloRequestPacket::getThermostatSerial() const {
-  return MUARTUtils::DecodeNBitString((pkt_.getBytes() + 4), 8, 6);
+  return MUARTUtils::DecodeNBitString((pkt_->getBytes() + 4), 8, 6);
 }
 
 std::string ThermostatHelloRequestPacket::getThermostatVersionString() const {
   char buf[16];
   sprintf(buf, "%02d.%02d.%02d",
-          pkt_.getPayloadByte(13),
-          pkt_.getPayloadByte(14),
-          pkt_.getPayloadByte(15));
+          pkt_->getPayloadByte(13),
+          pkt_->getPayloadByte(14),
+          pkt_->getPayloadByte(15));
 
   return buf;
 }
 
 // ErrorStateGetResponsePacket functions
 std::string ErrorStateGetResponsePacket::getShortCode() const {
+  char buf[8];
+  getShortCode(buf);
+  return buf;
+}
+
+void ErrorStateGetResponsePacket::formatShortCode(const uint8_t raw_short_code, char *buffer) {
   const char* upperAlphabet = "AbEFJLPU";
   const char* lowerAlphabet = "0123456789ABCDEFOHJLPU";
-  const uint8_t errorCode = this->getRawShortCode();
+  const uint8_t errorCode = raw_short_code;
 
   uint8_t lowBits = errorCode & 0x1F;
   if (lowBits > 0x15) {
-    char buf[7];
-    sprintf(buf, "ERR_%x", errorCode);
-    return buf;
+    sprintf(buffer, "ERR_%x", errorCode);
+    return;
   }
 
-  return {upperAlphabet[(errorCode & 0xE0) >> 5], lowerAlphabet[lowBits]};
+  buffer[0] = upperAlphabet[(errorCode & 0xE0) >> 5];
+  buffer[1] = lowerAlphabet[lowBits];
+  buffer[2] = '\0';
 }
 
 // ExtendedConnectResponsePacket functions
 uint8_t ExtendedConnectResponsePacket::getSupportedFanSpeeds() const {
-  uint8_t raw_value = ((pkt_.getPayloadByte(7) & 0x10) >> 2) + ((pkt_.getPayloadByte(8) & 0x08) >> 2) +
-                      ((pkt_.getPayloadByte(9) & 0x02) >> 1);
+  uint8_t raw_value = ((pkt_->getPayloadByte(7) & 0x10) >> 2) + ((pkt_->getPayloadByte(8) & 0x08) >> 2) +
+                      ((pkt_->getPayloadByte(9) & 0x02) >> 1);
 
   switch (raw_value) {
     case 1:
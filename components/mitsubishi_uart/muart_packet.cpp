@@ -1,75 +1,91 @@
 #include "muart_packet.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 
 namespace esphome {
 namespace mitsubishi_uart {
 
-// Creates an empty packet
-Packet::Packet() {
-  // TODO: Is this okay?
+PacketLogFormat Packet::logFormat = PacketLogFormat::detailed;
+
+static char format_hex_pretty_char(uint8_t v) { return v >= 10 ? 'A' + (v - 10) : '0' + v; }
+
+size_t Packet::appendf(char *buffer, size_t size, size_t pos, const char *format, ...) {
+  if (pos >= size) return pos;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(buffer + pos, size - pos, format, args);
+  va_end(args);
+  if (written < 0) return pos;
+  // vsnprintf returns what it would have written, so clamp to what actually fit
+  return std::min(pos + written, size - 1);
 }
 
-// std::string Packet::to_string() const {
-//   return format_hex_pretty(&pkt_.getBytes()[0], pkt_.getLength());
-// }
+size_t Packet::formatHex(const uint8_t *bytes, const uint8_t length, char *buffer, const size_t size) {
+  if (size == 0) return 0;
+  size_t pos = 0;
+  for (uint8_t i = 0; i < length && pos + 3 < size; i++) {
+    if (i > 0) buffer[pos++] = '.';
+    buffer[pos++] = format_hex_pretty_char((bytes[i] & 0xF0) >> 4);
+    buffer[pos++] = format_hex_pretty_char(bytes[i] & 0x0F);
+  }
+  buffer[pos] = '\0';
+  return pos;
+}
 
-static char format_hex_pretty_char(uint8_t v) { return v >= 10 ? 'A' + (v - 10) : '0' + v; }
+size_t Packet::format(char *buffer, const size_t size) const {
+  if (size == 0) return 0;
+  if (logFormat == PacketLogFormat::hex) return formatHex(pkt_->getBytes(), pkt_->getLength(), buffer, size);
+  return formatDetailed(buffer, size);
+}
 
 std::string Packet::to_string() const {
-  // Based on `format_hex_pretty` from ESPHome
-  if (pkt_.getLength() < PACKET_HEADER_SIZE)
-    return "";
-  std::stringstream stream;
-
-  stream << CONSOLE_COLOR_CYAN; //Cyan
-  stream << '[';
+  char buffer[PACKET_LOG_BUFFER_SIZE];
+  format(buffer, sizeof(buffer));
+  return buffer;
+}
 
-  for (size_t i = 0; i < PACKET_HEADER_SIZE; i++) {
-    if (i==1) {stream << CONSOLE_COLOR_CYAN_BOLD;}
-    stream << format_hex_pretty_char((pkt_.getBytes()[i] & 0xF0) >> 4);
-    stream << format_hex_pretty_char(pkt_.getBytes()[i] & 0x0F);
-    if (i<PACKET_HEADER_SIZE-1){
-      stream << '.';
-    }
-    if (i==1) {stream << CONSOLE_COLOR_CYAN;}
+size_t Packet::formatDetailed(char *buffer, const size_t size) const {
+  // Based on `format_hex_pretty` from ESPHome
+  buffer[0] = '\0';
+  if (pkt_->getLength() < PACKET_HEADER_SIZE) return 0;
+  const uint8_t *bytes = pkt_->getBytes();
+  const uint8_t length = pkt_->getLength();
+
+  // Header, with the packet type in bold
+  size_t pos = appendf(buffer, size, 0, "%s[%02X.%s%02X%s", CONSOLE_COLOR_CYAN, bytes[0], CONSOLE_COLOR_CYAN_BOLD,
+                       bytes[1], CONSOLE_COLOR_CYAN);
+  for (size_t i = 2; i < PACKET_HEADER_SIZE; i++) {
+    pos = appendf(buffer, size, pos, ".%02X", bytes[i]);
   }
-  // Header close-bracket
-  stream << ']';
-  stream << CONSOLE_COLOR_WHITE; //White
+  pos = appendf(buffer, size, pos, "]%s", CONSOLE_COLOR_WHITE);
 
   // Payload
-  for (size_t i = PACKET_HEADER_SIZE; i < pkt_.getLength()-1; i++) {
-    stream << format_hex_pretty_char((pkt_.getBytes()[i] & 0xF0) >> 4);
-    stream << format_hex_pretty_char(pkt_.getBytes()[i] & 0x0F);
-    if (i<pkt_.getLength()-2){
-      stream << '.';
-    }
+  for (size_t i = PACKET_HEADER_SIZE; i + 1 < length; i++) {
+    pos = appendf(buffer, size, pos, i + 2 < length ? "%02X." : "%02X", bytes[i]);
   }
 
-  // Space
-  stream << ' ';
-  stream << CONSOLE_COLOR_GREEN; //Green
-
   // Checksum
-  stream << format_hex_pretty_char((pkt_.getBytes()[pkt_.getLength()-1] & 0xF0) >> 4);
-  stream << format_hex_pretty_char(pkt_.getBytes()[pkt_.getLength()-1] & 0x0F);
-
-  stream << CONSOLE_COLOR_NONE; //Reset
-
-  return stream.str();
+  return appendf(buffer, size, pos, " %s%02X%s", CONSOLE_COLOR_GREEN, bytes[length - 1], CONSOLE_COLOR_NONE);
 }
 
+size_t Packet::formatNamed(char *buffer, const size_t size, const char *name) const {
+  size_t pos = appendf(buffer, size, 0, "%s: ", name);
+  if (pos >= size - 1) return pos;
+  return pos + Packet::formatDetailed(buffer + pos, size - pos);
+}
 
 void Packet::setFlags(const uint8_t flagValue) {
-  pkt_.setPayloadByte(PLINDEX_FLAGS, flagValue);
+  pkt_->setPayloadByte(PLINDEX_FLAGS, flagValue);
 }
 
 // Adds a flag (ONLY APPLICABLE FOR SOME COMMANDS)
 void Packet::addFlag(const uint8_t flagToAdd) {
-  pkt_.setPayloadByte(PLINDEX_FLAGS, pkt_.getPayloadByte(PLINDEX_FLAGS) | flagToAdd);
+  pkt_->setPayloadByte(PLINDEX_FLAGS, pkt_->getPayloadByte(PLINDEX_FLAGS) | flagToAdd);
 }
 // Adds a flag2 (ONLY APPLICABLE FOR SOME COMMANDS)
 void Packet::addFlag2(const uint8_t flag2ToAdd) {
-  pkt_.setPayloadByte(PLINDEX_FLAGS2, pkt_.getPayloadByte(PLINDEX_FLAGS2) | flag2ToAdd);
+  pkt_->setPayloadByte(PLINDEX_FLAGS2, pkt_->getPayloadByte(PLINDEX_FLAGS2) | flag2ToAdd);
 }
 
 }  // namespace mitsubishi_uart
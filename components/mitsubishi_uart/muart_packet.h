@@ -1,16 +1,62 @@
 #pragma once
 
+#include "esphome/core/defines.h"
 #include "esphome/core/component.h"
 #include "esphome/components/climate/climate.h"
 #include "esphome/components/uart/uart.h"
+#ifdef USE_LOGGER
+#include "esphome/components/logger/logger.h"
+#endif
 #include "muart_rawpacket.h"
 #include "muart_utils.h"
-#include <sstream>
+#include <array>
+#include <string>
 
 namespace esphome {
 namespace mitsubishi_uart {
-static const char *PACKETS_TAG = "mitsubishi_uart.packets";
-#define LOGPACKET(packet, direction) ESP_LOGD(PACKETS_TAG, "%s [%02x] %s", direction, packet.getPacketType(), packet.to_string().c_str());
+static const char *const PACKETS_TAG = "mitsubishi_uart.packets";
+
+// Size of the stack buffer packets are formatted into for logging (long enough for the most detailed packet)
+static const size_t PACKET_LOG_BUFFER_SIZE = 512;
+
+// Returns true if a message at `level` for `tag` would actually be logged, so we can skip formatting it otherwise
+inline bool packetLogEnabled(const int level, const char *tag) {
+#ifdef USE_LOGGER
+  return logger::global_logger != nullptr && logger::global_logger->level_for(tag) >= level;
+#else
+  return false;
+#endif
+}
+
+/* Logs `message` with a "%s" replaced by the packet's description.  The packet is only formatted (into a
+stack buffer) if the level is both compiled in and enabled for `tag` at runtime.*/
+#define MUART_LOG_PACKET(level, log_macro, tag, message, packet) \
+  do { \
+    if (ESPHOME_LOG_LEVEL >= (level) && packetLogEnabled((level), (tag))) { \
+      char packetLogBuffer[PACKET_LOG_BUFFER_SIZE]; \
+      (packet).format(packetLogBuffer, sizeof(packetLogBuffer)); \
+      log_macro((tag), message, packetLogBuffer); \
+    } \
+  } while (0)
+#define LOGPACKETD(tag, message, packet) MUART_LOG_PACKET(ESPHOME_LOG_LEVEL_DEBUG, ESP_LOGD, tag, message, packet)
+#define LOGPACKETV(tag, message, packet) MUART_LOG_PACKET(ESPHOME_LOG_LEVEL_VERBOSE, ESP_LOGV, tag, message, packet)
+#define LOGPACKET(packet, direction) LOGPACKETD(PACKETS_TAG, direction " %s", packet)
+
+// Same as MUART_LOG_PACKET, but for raw frame bytes that aren't wrapped in a Packet
+#define LOGFRAMEV(tag, message, bytes, length) \
+  do { \
+    if (ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE && packetLogEnabled(ESPHOME_LOG_LEVEL_VERBOSE, (tag))) { \
+      char packetLogBuffer[PACKET_LOG_BUFFER_SIZE]; \
+      Packet::formatHex((bytes), (length), packetLogBuffer, sizeof(packetLogBuffer)); \
+      ESP_LOGV((tag), message, packetLogBuffer); \
+    } \
+  } while (0)
+
+// How packets are described in logs
+enum class PacketLogFormat : uint8_t {
+  detailed,  // Packet name, colored bytes, and decoded fields
+  hex,       // Just the packet bytes as hex, for compact logs or feeding to other tools
+};
 
 #define CONSOLE_COLOR_NONE "\033[0m"
 #define CONSOLE_COLOR_GREEN "\033[0;32m"
@@ -21,14 +67,29 @@ static const char *PACKETS_TAG = "mitsubishi_uart.packets";
 
 class PacketProcessor;
 
-// Generic Base Packet wrapper over RawPacket
+template<class P> class OwnedPacket;
+
+/* Generic Base Packet wrapper over RawPacket.  Packets are views over a RawPacket owned by someone else (the
+bridge's receive buffer for received packets, so the frame isn't copied just to be read), and are only valid
+while that RawPacket is.  Packets built to be sent, and received packets that need to be kept, are OwnedPackets.
+Views can't be copied, so a copy can't outlive the frame it points at.*/
 class Packet {
   public:
-    Packet(RawPacket&& pkt) : pkt_(std::move(pkt)) {}; // TODO: Confirm this needs std::move if call to constructor ALSO has move
-    Packet(); // For optional<> construction
-
-    // Returns a (more) human readable string of the packet
-    virtual std::string to_string() const;
+    explicit Packet(RawPacket *pkt) : pkt_(pkt) {};  // Creates a view over `pkt` without copying it
+    Packet(const Packet &other) = delete;
+    Packet &operator=(const Packet &other) = delete;
+    virtual ~Packet() {}
+
+    /* Writes a description of the packet into `buffer` according to the current PacketLogFormat, and returns the
+    number of characters written.  Never writes more than `size` bytes (including the terminating null).*/
+    size_t format(char *buffer, size_t size) const;
+    // Returns a (more) human readable string of the packet.  This allocates, so prefer format() or LOGPACKETx.
+    std::string to_string() const;
+
+    // Sets how packets are described by format() and the packet logging macros
+    static void set_log_format(PacketLogFormat log_format) { logFormat = log_format; };
+    // Writes `length` bytes as dot-separated hex into `buffer`, returning the number of characters written
+    static size_t formatHex(const uint8_t *bytes, uint8_t length, char *buffer, size_t size);
 
     // Is a response packet expected when this packet is sent.  Defaults to true since
     // most requests receive a response.
@@ -36,12 +97,13 @@ class Packet {
     void setResponseExpected(bool expectResponse) {responseExpected = expectResponse;};
 
     // Passthrough methods to RawPacket
-    RawPacket& rawPacket() {return pkt_;};
-    uint8_t getPacketType() const {return pkt_.getPacketType();}
-    bool isChecksumValid() const {return pkt_.isChecksumValid();};
+    RawPacket& rawPacket() {return *pkt_;};
+    const RawPacket& rawPacket() const {return *pkt_;};
+    uint8_t getPacketType() const {return pkt_->getPacketType();}
+    bool isChecksumValid() const {return pkt_->isChecksumValid();};
 
     // Returns flags (ONLY APPLICABLE FOR SOME COMMANDS)
-    uint8_t getFlags() const {return pkt_.getPayloadByte(PLINDEX_FLAGS);}
+    uint8_t getFlags() const {return pkt_->getPayloadByte(PLINDEX_FLAGS);}
     // Sets flags (ONLY APPLICABLE FOR SOME COMMANDS)
     void setFlags(const uint8_t flagValue);
     // Adds a flag (ONLY APPLICABLE FOR SOME COMMANDS)
@@ -49,16 +111,48 @@ class Packet {
     // Adds a flag2 (ONLY APPLICABLE FOR SOME COMMANDS)
     void addFlag2(const uint8_t flag2ToAdd);
 
-    SourceBridge getSourceBridge() const { return pkt_.getSourceBridge(); }
-    ControllerAssociation getControllerAssociation() const { return pkt_.getControllerAssociation(); }
+    SourceBridge getSourceBridge() const { return pkt_->getSourceBridge(); }
+    ControllerAssociation getControllerAssociation() const { return pkt_->getControllerAssociation(); }
 
   protected:
     static const int PLINDEX_FLAGS = 1;
     static const int PLINDEX_FLAGS2 = 2;
 
-    RawPacket pkt_;
+    // Writes the detailed description of the packet.  Subclasses override this to add a name and decoded fields.
+    virtual size_t formatDetailed(char *buffer, size_t size) const;
+    // Writes "`name`: " followed by the packet's colored bytes
+    size_t formatNamed(char *buffer, size_t size, const char *name) const;
+    // snprintf to `buffer` + `pos`, returning the new length (never more than fits in `size`)
+    static size_t appendf(char *buffer, size_t size, size_t pos, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+    RawPacket *pkt_;
   private:
     bool responseExpected = true;
+    static PacketLogFormat logFormat;
+};
+
+// The frame of an OwnedPacket, as a base class so it's constructed before the packet that views it
+struct OwnedFrame {
+  RawPacket ownedFrame_;
+};
+
+/* A packet of class P that owns its frame: packets built to be sent (see each class's create()), and copies of
+received packets that need to outlive the frame they arrived in.  Copies view their own copy of the frame.*/
+template<class P> class OwnedPacket : private OwnedFrame, public P {
+  public:
+    explicit OwnedPacket(const RawPacket &raw) : OwnedFrame{raw}, P(&ownedFrame_) {};
+    // Copies a packet (usually a view over a received frame) so it can be kept
+    explicit OwnedPacket(const P &packet) : OwnedFrame{packet.rawPacket()}, P(&ownedFrame_) {
+      this->setResponseExpected(packet.isResponseExpected());
+    };
+    OwnedPacket(const OwnedPacket &other) : OwnedFrame{other.ownedFrame_}, P(&ownedFrame_) {
+      this->setResponseExpected(other.isResponseExpected());
+    };
+    OwnedPacket &operator=(const OwnedPacket &other) {
+      ownedFrame_ = other.ownedFrame_;
+      this->setResponseExpected(other.isResponseExpected());
+      return *this;
+    };
 };
 
 ////
@@ -68,23 +162,24 @@ class ConnectRequestPacket : public Packet {
  public:
   using Packet::Packet;
   static ConnectRequestPacket& instance() {
-    static ConnectRequestPacket INSTANCE;
+    static OwnedPacket<ConnectRequestPacket> INSTANCE = create();
     return INSTANCE;
   }
-
-  std::string to_string() const override;
- private:
-  ConnectRequestPacket() : Packet(RawPacket(PacketType::connect_request, 2)) {
-    pkt_.setPayloadByte(0, 0xca);
-    pkt_.setPayloadByte(1, 0x01);
+  static OwnedPacket<ConnectRequestPacket> create() {
+    OwnedPacket<ConnectRequestPacket> packet(RawPacket(PacketType::connect_request, 2));
+    packet.rawPacket().setPayloadByte(0, 0xca);
+    packet.rawPacket().setPayloadByte(1, 0x01);
+    return packet;
   }
+
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 class ConnectResponsePacket : public Packet {
 
   public:
     using Packet::Packet;
-    std::string to_string() const override;
+    size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 ////
@@ -93,14 +188,15 @@ class ConnectResponsePacket : public Packet {
 class ExtendedConnectRequestPacket : public Packet {
  public:
   static ExtendedConnectRequestPacket& instance() {
-    static ExtendedConnectRequestPacket INSTANCE;
+    static OwnedPacket<ExtendedConnectRequestPacket> INSTANCE = create();
     return INSTANCE;
   }
-  using Packet::Packet;
- private:
-  ExtendedConnectRequestPacket() : Packet(RawPacket(PacketType::extended_connect_request, 1)) {
-    pkt_.setPayloadByte(0, 0xc9);
+  static OwnedPacket<ExtendedConnectRequestPacket> create() {
+    OwnedPacket<ExtendedConnectRequestPacket> packet(RawPacket(PacketType::extended_connect_request, 1));
+    packet.rawPacket().setPayloadByte(0, 0xc9);
+    return packet;
   }
+  using Packet::Packet;
 };
 
 class ExtendedConnectResponsePacket : public Packet {
@@ -108,29 +204,29 @@ class ExtendedConnectResponsePacket : public Packet {
 
  public:
   // Byte 7
-  bool isHeatDisabled() const { return pkt_.getPayloadByte(7) & 0x02; }
-  bool supportsVane() const { return pkt_.getPayloadByte(7) & 0x20; }
-  bool supportsVaneSwing() const { return pkt_.getPayloadByte(7) & 0x40; }
+  bool isHeatDisabled() const { return pkt_->getPayloadByte(7) & 0x02; }
+  bool supportsVane() const { return pkt_->getPayloadByte(7) & 0x20; }
+  bool supportsVaneSwing() const { return pkt_->getPayloadByte(7) & 0x40; }
 
   // Byte 8
-  bool isDryDisabled() const { return pkt_.getPayloadByte(8) & 0x01; }
-  bool isFanDisabled() const { return pkt_.getPayloadByte(8) & 0x02; }
-  bool hasExtendedTemperatureRange() const { return pkt_.getPayloadByte(8) & 0x04; }
-  bool autoFanSpeedDisabled() const { return pkt_.getPayloadByte(8) & 0x10; }
-  bool supportsInstallerSettings() const { return pkt_.getPayloadByte(8) & 0x20; }
-  bool supportsTestMode() const { return pkt_.getPayloadByte(8) & 0x40; }
-  bool supportsDryTemperature() const { return pkt_.getPayloadByte(8) & 0x80; }
+  bool isDryDisabled() const { return pkt_->getPayloadByte(8) & 0x01; }
+  bool isFanDisabled() const { return pkt_->getPayloadByte(8) & 0x02; }
+  bool hasExtendedTemperatureRange() const { return pkt_->getPayloadByte(8) & 0x04; }
+  bool autoFanSpeedDisabled() const { return pkt_->getPayloadByte(8) & 0x10; }
+  bool supportsInstallerSettings() const { return pkt_->getPayloadByte(8) & 0x20; }
+  bool supportsTestMode() const { return pkt_->getPayloadByte(8) & 0x40; }
+  bool supportsDryTemperature() const { return pkt_->getPayloadByte(8) & 0x80; }
 
   // Byte 9
-  bool hasStatusDisplay() const { return pkt_.getPayloadByte(9) & 0x01; }
+  bool hasStatusDisplay() const { return pkt_->getPayloadByte(9) & 0x01; }
 
   // Bytes 10-15
-  float getMinCoolDrySetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(10)); }
-  float getMaxCoolDrySetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(11)); }
-  float getMinHeatingSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(12)); }
-  float getMaxHeatingSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(13)); }
-  float getMinAutoSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(14)); }
-  float getMaxAutoSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_.getPayloadByte(15)); }
+  float getMinCoolDrySetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(10)); }
+  float getMaxCoolDrySetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(11)); }
+  float getMinHeatingSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(12)); }
+  float getMaxHeatingSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(13)); }
+  float getMinAutoSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(14)); }
+  float getMaxAutoSetpoint() const { return MUARTUtils::TempScaleAToDegC(pkt_->getPayloadByte(15)); }
 
   // Things that have to exist, but we don't know where yet.
   bool supportsHVane() const { return true; }
@@ -142,7 +238,7 @@ class ExtendedConnectResponsePacket : public Packet {
   // This will also not handle things like MHK2 humidity detection.
   climate::ClimateTraits asTraits() const;
 
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 ////
@@ -151,31 +247,32 @@ class ExtendedConnectResponsePacket : public Packet {
 class GetRequestPacket : public Packet {
  public:
   static GetRequestPacket& getSettingsInstance() {
-    static GetRequestPacket INSTANCE = GetRequestPacket(GetCommand::settings);
+    static OwnedPacket<GetRequestPacket> INSTANCE = forCommand(GetCommand::settings);
     return INSTANCE;
   }
   static GetRequestPacket& getCurrentTempInstance() {
-    static GetRequestPacket INSTANCE = GetRequestPacket(GetCommand::current_temp);
+    static OwnedPacket<GetRequestPacket> INSTANCE = forCommand(GetCommand::current_temp);
     return INSTANCE;
   }
   static GetRequestPacket& getStatusInstance() {
-    static GetRequestPacket INSTANCE = GetRequestPacket(GetCommand::standby);
+    static OwnedPacket<GetRequestPacket> INSTANCE = forCommand(GetCommand::status);
     return INSTANCE;
   }
   static GetRequestPacket& getStandbyInstance() {
-    static GetRequestPacket INSTANCE = GetRequestPacket(GetCommand::status);
+    static OwnedPacket<GetRequestPacket> INSTANCE = forCommand(GetCommand::standby);
     return INSTANCE;
   }
   static GetRequestPacket& getErrorInfoInstance() {
-    static GetRequestPacket INSTANCE = GetRequestPacket(GetCommand::error_info);
+    static OwnedPacket<GetRequestPacket> INSTANCE = forCommand(GetCommand::error_info);
     return INSTANCE;
   }
-  using Packet::Packet;
-
- private:
-  GetRequestPacket(GetCommand get_command) : Packet(RawPacket(PacketType::get_request, 1)) {
-    pkt_.setPayloadByte(0, static_cast<uint8_t>(get_command));
+  // Returns a request for any GetCommand (used when the command isn't known until runtime)
+  static OwnedPacket<GetRequestPacket> forCommand(GetCommand get_command) {
+    OwnedPacket<GetRequestPacket> packet(RawPacket(PacketType::get_request, 1));
+    packet.rawPacket().setPayloadByte(0, static_cast<uint8_t>(get_command));
+    return packet;
   }
+  using Packet::Packet;
 };
 
 class SettingsGetResponsePacket : public Packet {
@@ -190,19 +287,19 @@ class SettingsGetResponsePacket : public Packet {
   using Packet::Packet;
 
  public:
-  uint8_t getPower() const { return pkt_.getPayloadByte(PLINDEX_POWER); }
-  uint8_t getMode() const { return pkt_.getPayloadByte(PLINDEX_MODE); }
-  uint8_t getFan() const { return pkt_.getPayloadByte(PLINDEX_FAN); }
-  uint8_t getVane() const { return pkt_.getPayloadByte(PLINDEX_VANE); }
-  bool lockedPower() const { return pkt_.getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x01; }
-  bool lockedMode() const { return pkt_.getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x02; }
-  bool lockedTemp() const { return pkt_.getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x04; }
-  uint8_t getHorizontalVane() const { return pkt_.getPayloadByte(PLINDEX_HVANE) & 0x7F; }
-  bool getHorizontalVaneMSB() const { return pkt_.getPayloadByte(PLINDEX_HVANE) & 0x80; }
+  uint8_t getPower() const { return pkt_->getPayloadByte(PLINDEX_POWER); }
+  uint8_t getMode() const { return pkt_->getPayloadByte(PLINDEX_MODE); }
+  uint8_t getFan() const { return pkt_->getPayloadByte(PLINDEX_FAN); }
+  uint8_t getVane() const { return pkt_->getPayloadByte(PLINDEX_VANE); }
+  bool lockedPower() const { return pkt_->getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x01; }
+  bool lockedMode() const { return pkt_->getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x02; }
+  bool lockedTemp() const { return pkt_->getPayloadByte(PLINDEX_PROHIBITFLAGS) & 0x04; }
+  uint8_t getHorizontalVane() const { return pkt_->getPayloadByte(PLINDEX_HVANE) & 0x7F; }
+  bool getHorizontalVaneMSB() const { return pkt_->getPayloadByte(PLINDEX_HVANE) & 0x80; }
 
   float getTargetTemp() const;
 
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 class CurrentTempGetResponsePacket : public Packet {
@@ -212,7 +309,7 @@ class CurrentTempGetResponsePacket : public Packet {
 
  public:
   float getCurrentTemp() const;
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 class StatusGetResponsePacket : public Packet {
@@ -223,11 +320,16 @@ class StatusGetResponsePacket : public Packet {
 
 
  public:
-  uint8_t getCompressorFrequency() const { return pkt_.getPayloadByte(PLINDEX_COMPRESSOR_FREQUENCY); }
-  bool getOperating() const { return pkt_.getPayloadByte(PLINDEX_OPERATING); }
-  std::string to_string() const override;
+  uint8_t getCompressorFrequency() const { return pkt_->getPayloadByte(PLINDEX_COMPRESSOR_FREQUENCY); }
+  bool getOperating() const { return pkt_->getPayloadByte(PLINDEX_OPERATING); }
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
+// these names come from Kumo. They are bad, but I am also too lazy to think of better names. they also
+// may not map perfectly yet?
+const std::array<std::string, 7> ACTUAL_FAN_SPEED_NAMES = {"Off", "Very Low", "Quiet", "Low", "Powerful",
+                                                           "Super Powerful", "Super Quiet"};
+
 class StandbyGetResponsePacket : public Packet {
   static const int PLINDEX_STATUSFLAGS = 3;
   static const int PLINDEX_ACTUALFAN = 4;
@@ -235,25 +337,28 @@ class StandbyGetResponsePacket : public Packet {
   using Packet::Packet;
 
  public:
-  bool serviceFilter() const { return pkt_.getPayloadByte(PLINDEX_STATUSFLAGS) & 0x01; }
-  bool inDefrost() const { return pkt_.getPayloadByte(PLINDEX_STATUSFLAGS) & 0x02; }
-  bool inHotAdjust() const { return pkt_.getPayloadByte(PLINDEX_STATUSFLAGS) & 0x04; }
-  bool inStandby() const { return pkt_.getPayloadByte(PLINDEX_STATUSFLAGS) & 0x08; }
-  uint8_t getActualFanSpeed() const { return pkt_.getPayloadByte(PLINDEX_ACTUALFAN); }
-  uint8_t getAutoMode() const { return pkt_.getPayloadByte(PLINDEX_AUTOMODE); }
-  std::string to_string() const override;
+  bool serviceFilter() const { return pkt_->getPayloadByte(PLINDEX_STATUSFLAGS) & 0x01; }
+  bool inDefrost() const { return pkt_->getPayloadByte(PLINDEX_STATUSFLAGS) & 0x02; }
+  bool inHotAdjust() const { return pkt_->getPayloadByte(PLINDEX_STATUSFLAGS) & 0x04; }
+  bool inStandby() const { return pkt_->getPayloadByte(PLINDEX_STATUSFLAGS) & 0x08; }
+  uint8_t getActualFanSpeed() const { return pkt_->getPayloadByte(PLINDEX_ACTUALFAN); }
+  uint8_t getAutoMode() const { return pkt_->getPayloadByte(PLINDEX_AUTOMODE); }
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 class ErrorStateGetResponsePacket : public Packet {
   using Packet::Packet;
  public:
-  uint16_t getErrorCode() const {return pkt_.getPayloadByte(4) << 8 | pkt_.getPayloadByte(5);}
-  uint8_t getRawShortCode() const {return pkt_.getPayloadByte(6);}
+  uint16_t getErrorCode() const {return pkt_->getPayloadByte(4) << 8 | pkt_->getPayloadByte(5);}
+  uint8_t getRawShortCode() const {return pkt_->getPayloadByte(6);}
   std::string getShortCode() const;
+  // Writes the short code into `buffer`, which must hold at least 8 characters
+  void getShortCode(char *buffer) const { formatShortCode(getRawShortCode(), buffer); }
+  static void formatShortCode(uint8_t raw_short_code, char *buffer);
 
   bool errorPresent() const { return getErrorCode() != 0x8000 || getRawShortCode() != 0x00; }
 
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 ////
@@ -320,7 +425,12 @@ class SettingsSetRequestPacket : public Packet {
     HV_SWING = 0x0c,
   };
 
-  SettingsSetRequestPacket() : Packet(RawPacket(PacketType::set_request, 16)) { pkt_.setPayloadByte(0, static_cast<uint8_t>(SetCommand::settings)); }
+  // A new settings change, with nothing set yet
+  static OwnedPacket<SettingsSetRequestPacket> create() {
+    OwnedPacket<SettingsSetRequestPacket> packet(RawPacket(PacketType::set_request, 16));
+    packet.rawPacket().setPayloadByte(0, static_cast<uint8_t>(SetCommand::settings));
+    return packet;
+  }
   using Packet::Packet;
 
   SettingsSetRequestPacket &setPower(bool isOn);
@@ -330,6 +440,9 @@ class SettingsSetRequestPacket : public Packet {
   SettingsSetRequestPacket &setVane(VANE_BYTE vane);
   SettingsSetRequestPacket &setHorizontalVane(HORIZONTAL_VANE_BYTE horizontal_vane);
 
+  // Copies every setting flagged in `newer` into this packet, so both changes can be sent as one
+  SettingsSetRequestPacket &merge(const SettingsSetRequestPacket &newer);
+
  private:
   void addSettingsFlag(SETTING_FLAG flagToAdd);
   void addSettingsFlag2(SETTING_FLAG2 flag2ToAdd);
@@ -340,8 +453,10 @@ class RemoteTemperatureSetRequestPacket : public Packet {
   static const uint8_t PLINDEX_REMOTE_TEMPERATURE = 3;
 
   public:
-  RemoteTemperatureSetRequestPacket() : Packet(RawPacket(PacketType::set_request, 4)) {
-    pkt_.setPayloadByte(0, static_cast<uint8_t>(SetCommand::remote_temperature));
+  static OwnedPacket<RemoteTemperatureSetRequestPacket> create() {
+    OwnedPacket<RemoteTemperatureSetRequestPacket> packet(RawPacket(PacketType::set_request, 4));
+    packet.rawPacket().setPayloadByte(0, static_cast<uint8_t>(SetCommand::remote_temperature));
+    return packet;
   }
   using Packet::Packet;
 
@@ -350,15 +465,17 @@ class RemoteTemperatureSetRequestPacket : public Packet {
   RemoteTemperatureSetRequestPacket &setRemoteTemperature(float temperatureDegressC);
   RemoteTemperatureSetRequestPacket &useInternalTemperature();
 
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 class SetResponsePacket : public Packet {
   using Packet::Packet;
 public:
-  SetResponsePacket() : Packet(RawPacket(PacketType::set_response, 16)) {}
+  static OwnedPacket<SetResponsePacket> create() {
+    return OwnedPacket<SetResponsePacket>(RawPacket(PacketType::set_response, 16));
+  }
 
-  uint8_t getResultCode() const { return pkt_.getPayloadByte(0); }
+  uint8_t getResultCode() const { return pkt_->getPayloadByte(0); }
   bool isSuccessful() const { return getResultCode() == 0; }
 };
 
@@ -366,41 +483,59 @@ public:
 class ThermostatHelloRequestPacket : public Packet {
   using Packet::Packet;
  public:
-  ThermostatHelloRequestPacket() : Packet(RawPacket(PacketType::set_request, 4)) {
-    pkt_.setPayloadByte(0, static_cast<uint8_t>(SetCommand::thermostat_hello));
+  static OwnedPacket<ThermostatHelloRequestPacket> create() {
+    OwnedPacket<ThermostatHelloRequestPacket> packet(RawPacket(PacketType::set_request, 4));
+    packet.rawPacket().setPayloadByte(0, static_cast<uint8_t>(SetCommand::thermostat_hello));
+    return packet;
   }
 
   std::string getThermostatModel() const;
   std::string getThermostatSerial() const;
   std::string getThermostatVersionString() const;
 
-  std::string to_string() const override;
+  size_t formatDetailed(char *buffer, size_t size) const override;
 };
 
 // Sent by MHK2 but with no response; defined to allow setResponseExpected(false)
 class A9GetRequestPacket : public Packet {
   using Packet::Packet;
  public:
-  A9GetRequestPacket() : Packet(RawPacket(PacketType::get_request, 10)) {
-    pkt_.setPayloadByte(0, static_cast<uint8_t>(GetCommand::a_9));
+  static OwnedPacket<A9GetRequestPacket> create() {
+    OwnedPacket<A9GetRequestPacket> packet(RawPacket(PacketType::get_request, 10));
+    packet.rawPacket().setPayloadByte(0, static_cast<uint8_t>(GetCommand::a_9));
+    return packet;
   }
 };
 
+/* Every packet class, with the packet type and command it's received as, and whether the receiver needs to respond.
+PacketProcessor's overloads and the dispatch table (muart_packet_dispatch.h) are both generated from this list, so
+to handle a new packet, define its class above and add it here.  Entries for a specific command must come before
+an ANY_COMMAND entry for the same packet type.*/
+#define MUART_PACKETS(PACKET) \
+  PACKET(connect_request, ANY_COMMAND, ConnectRequestPacket, true) \
+  PACKET(connect_response, ANY_COMMAND, ConnectResponsePacket, false) \
+  PACKET(extended_connect_request, ANY_COMMAND, ExtendedConnectRequestPacket, true) \
+  PACKET(extended_connect_response, ANY_COMMAND, ExtendedConnectResponsePacket, false) \
+  PACKET(get_request, ANY_COMMAND, GetRequestPacket, true) \
+  PACKET(get_response, GetCommand::settings, SettingsGetResponsePacket, false) \
+  PACKET(get_response, GetCommand::current_temp, CurrentTempGetResponsePacket, false) \
+  PACKET(get_response, GetCommand::error_info, ErrorStateGetResponsePacket, false) \
+  PACKET(get_response, GetCommand::standby, StandbyGetResponsePacket, false) \
+  PACKET(get_response, GetCommand::status, StatusGetResponsePacket, false) \
+  PACKET(get_response, GetCommand::a_9, A9GetRequestPacket, false) \
+  PACKET(set_request, SetCommand::remote_temperature, RemoteTemperatureSetRequestPacket, true) \
+  PACKET(set_request, SetCommand::settings, SettingsSetRequestPacket, true) \
+  PACKET(set_request, SetCommand::thermostat_hello, ThermostatHelloRequestPacket, false) \
+  PACKET(set_response, ANY_COMMAND, SetResponsePacket, false)
+
+// Receives packets as their own class.  Packets without an override are handled as a generic Packet.
 class PacketProcessor {
   public:
     virtual void processPacket(const Packet &packet) {};
-    virtual void processPacket(const ConnectRequestPacket &packet) {};
-    virtual void processPacket(const ConnectResponsePacket &packet) {};
-    virtual void processPacket(const ExtendedConnectRequestPacket &packet) {};
-    virtual void processPacket(const ExtendedConnectResponsePacket &packet) {};
-    virtual void processPacket(const GetRequestPacket &packet) {};
-    virtual void processPacket(const SettingsGetResponsePacket &packet) {};
-    virtual void processPacket(const CurrentTempGetResponsePacket &packet) {};
-    virtual void processPacket(const StatusGetResponsePacket &packet) {};
-    virtual void processPacket(const StandbyGetResponsePacket &packet) {};
-    virtual void processPacket(const ErrorStateGetResponsePacket &packet) {};
-    virtual void processPacket(const RemoteTemperatureSetRequestPacket &packet) {};
-    virtual void processPacket(const SetResponsePacket &packet) {};
+#define MUART_PACKET_PROCESSOR_OVERLOAD(type, command, P, response_expected) \
+    virtual void processPacket(const P &packet) { processPacket(static_cast<const Packet &>(packet)); };
+    MUART_PACKETS(MUART_PACKET_PROCESSOR_OVERLOAD)
+#undef MUART_PACKET_PROCESSOR_OVERLOAD
 };
 
 }  // namespace mitsubishi_uart
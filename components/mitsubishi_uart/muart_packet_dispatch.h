@@ -0,0 +1,58 @@
+#pragma once
+
+#include "muart_packet.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Used in place of a command byte to match every command of a packet type
+static const int16_t ANY_COMMAND = -1;
+
+// Wraps a received packet in a view of type P (without copying it) and hands it to the PacketProcessor
+template <class P> void dispatchPacket(PacketProcessor &processor, RawPacket &pkt, bool expectResponse) {
+  P packet(&pkt);
+  packet.setResponseExpected(expectResponse);
+  processor.processPacket(packet);
+}
+
+// Describes how to process a received packet with a given packet type and command
+struct PacketDispatchEntry {
+  uint8_t packetType;
+  int16_t command;        // Command byte (first payload byte) to match, or ANY_COMMAND
+  bool responseExpected;  // Does the receiver of this packet need to respond to it
+  void (*dispatch)(PacketProcessor &processor, RawPacket &pkt, bool expectResponse);
+};
+
+// The dispatch table entry for packet class `P`, received as packets of `type` and `command`
+#define MUART_PACKET(type, command, P, response_expected) \
+  PacketDispatchEntry{static_cast<uint8_t>(PacketType::type), static_cast<int16_t>(command), response_expected, \
+                      &dispatchPacket<P>},
+
+// Every known packet (see MUART_PACKETS), in lookup order, then generic handling for unknown commands
+static constexpr PacketDispatchEntry PACKET_DISPATCH_TABLE[] = {
+    MUART_PACKETS(MUART_PACKET)
+    MUART_PACKET(get_response, ANY_COMMAND, Packet, false)
+    MUART_PACKET(set_request, ANY_COMMAND, Packet, true)
+};
+
+// Used for packets of unknown type.  If we get an unknown packet from the thermostat, expect a response.
+static constexpr PacketDispatchEntry UNKNOWN_PACKET_DISPATCH = {0, ANY_COMMAND, true, &dispatchPacket<Packet>};
+
+// Returns the dispatch entry for a packet (or UNKNOWN_PACKET_DISPATCH if it isn't registered)
+inline const PacketDispatchEntry &lookupPacketDispatch(const uint8_t packetType, const uint8_t command) {
+  for (const PacketDispatchEntry &entry : PACKET_DISPATCH_TABLE) {
+    if (entry.packetType == packetType && (entry.command == ANY_COMMAND || entry.command == command)) {
+      return entry;
+    }
+  }
+  return UNKNOWN_PACKET_DISPATCH;
+}
+
+// Hands a received packet to the PacketProcessor as its registered packet class
+inline void dispatchRawPacket(PacketProcessor &processor, RawPacket &pkt) {
+  const PacketDispatchEntry &entry = lookupPacketDispatch(pkt.getPacketType(), pkt.getCommand());
+  entry.dispatch(processor, pkt, entry.responseExpected);
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,141 @@
+#include "muart_packetqueue.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// The thermostat's packets go ahead of ours, and polls we generate can wait behind everything else
+QueueLane PacketQueue::laneFor(const Packet &packet) {
+  if (packet.getControllerAssociation() == ControllerAssociation::thermostat) {
+    return QueueLane::thermostat;
+  }
+  if (packet.getPacketType() == static_cast<uint8_t>(PacketType::get_request)
+      && packet.getControllerAssociation() == ControllerAssociation::muart) {
+    return QueueLane::poll;
+  }
+  return QueueLane::control;
+}
+
+// Returns a queued get request with the same bytes and controller as `packet`, or nullptr if there isn't one
+QueuedFrame *PacketQueue::findDuplicate(Lane &lane, const Packet &packet) {
+  if (packet.getPacketType() != static_cast<uint8_t>(PacketType::get_request)) return nullptr;
+
+  const RawPacket &raw = packet.rawPacket();
+  for (uint8_t i = 0; i < lane.count; i++) {
+    QueuedFrame &frame = lane.at(i);
+    if (frame.length == raw.getLength() && frame.controllerAssociation == raw.getControllerAssociation()
+        && memcmp(frame.bytes, raw.getBytes(), frame.length) == 0) {
+      return &frame;
+    }
+  }
+  return nullptr;
+}
+
+// Settings changes we generate (but not ones forwarded from the thermostat, which expects its own response)
+bool PacketQueue::isSettingsRequest(const RawPacket &raw) {
+  return raw.getPacketType() == static_cast<uint8_t>(PacketType::set_request)
+      && raw.getCommand() == static_cast<uint8_t>(SetCommand::settings)
+      && raw.getControllerAssociation() == ControllerAssociation::muart;
+}
+
+// Returns the settings set request waiting in `lane`, or nullptr if there isn't one
+QueuedFrame *PacketQueue::findSettingsRequest(Lane &lane) {
+  for (uint8_t i = 0; i < lane.count; i++) {
+    QueuedFrame &frame = lane.at(i);
+    if (isSettingsRequest(frame.rawPacket())) return &frame;
+  }
+  return nullptr;
+}
+
+bool ResponseCallbacks::add(const ResponseCallback &callback) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (callbacks[i] == callback) return true;
+  }
+  if (count >= MAX_FRAME_CALLBACKS) return false;
+  callbacks[count++] = callback;
+  return true;
+}
+
+void ResponseCallbacks::complete(const RawPacket *response) const {
+  for (uint8_t i = 0; i < count; i++) callbacks[i](response);
+}
+
+// Adds `callback` to a frame already in the queue, so the one response will complete every caller
+bool PacketQueue::mergeCallback(QueuedFrame &frame, const ResponseCallback &callback) {
+  return !callback || frame.callbacks.add(callback);
+}
+
+bool PacketQueue::push(const Packet &packet, const ResponseCallback &callback) {
+  Lane &lane = lanes[static_cast<uint8_t>(laneFor(packet))];
+  const RawPacket &raw = packet.rawPacket();
+
+  if (QueuedFrame *duplicate = findDuplicate(lane, packet)) {
+    return mergeCallback(*duplicate, callback);
+  }
+
+  if (isSettingsRequest(raw)) {
+    if (QueuedFrame *pending = findSettingsRequest(lane)) {
+      // Only merge the change if its caller can be told when it's been sent
+      if (!mergeCallback(*pending, callback)) return false;
+      OwnedPacket<SettingsSetRequestPacket> merged(pending->rawPacket());
+      merged.merge(OwnedPacket<SettingsSetRequestPacket>(raw));
+      memcpy(pending->bytes, merged.rawPacket().getBytes(), pending->length);
+      return true;
+    }
+  }
+
+  if (lane.count >= MAX_QUEUE_SIZE) return false;
+
+  QueuedFrame &frame = lane.at(lane.count);
+  memcpy(frame.bytes, raw.getBytes(), raw.getLength());
+  frame.length = raw.getLength();
+  frame.controllerAssociation = raw.getControllerAssociation();
+  frame.responseExpected = packet.isResponseExpected();
+  frame.notBeforeMillis = millis() + (isSettingsRequest(raw) ? settingsCoalesceMs : 0);
+  frame.callbacks.clear();
+  if (callback) frame.callbacks.add(callback);
+  lane.count++;
+
+  return true;
+}
+
+QueuedFrame *PacketQueue::front() {
+  for (const Lane &lane : lanes) {
+    if (lane.count > 0) return front(static_cast<QueueLane>(&lane - lanes.data()));
+  }
+  return nullptr;
+}
+
+void PacketQueue::pop() {
+  for (const Lane &lane : lanes) {
+    if (lane.count > 0) return pop(static_cast<QueueLane>(&lane - lanes.data()));
+  }
+}
+
+QueuedFrame *PacketQueue::front(const QueueLane lane_id) {
+  Lane &lane = lanes[static_cast<uint8_t>(lane_id)];
+  if (lane.count == 0) return nullptr;
+
+  QueuedFrame &frame = lane.at(0);
+  if ((int32_t) (millis() - frame.notBeforeMillis) < 0) return nullptr;
+  return &frame;
+}
+
+void PacketQueue::pop(const QueueLane lane_id) {
+  Lane &lane = lanes[static_cast<uint8_t>(lane_id)];
+  if (lane.count == 0) return;
+
+  lane.at(0).callbacks.clear();
+  lane.head = (lane.head + 1) % MAX_QUEUE_SIZE;
+  lane.count--;
+}
+
+bool PacketQueue::empty() const { return size() == 0; }
+
+size_t PacketQueue::size() const {
+  size_t total = 0;
+  for (const Lane &lane : lanes) total += lane.count;
+  return total;
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "muart_packet.h"
+#include <array>
+#include <cstddef>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+/* Maximum number of packets allowed to be queued for sending in each lane.  In some circumstances the equipment response
+time can be very slow and packets would queue up faster than they were being received.  TODO: Not sure what size this should
+be, 4ish should be enough for almost all situations, so 8 seems plenty.*/
+static const uint8_t MAX_QUEUE_SIZE = 8;
+// Default time a settings set request waits in the queue for further changes to be merged into it
+static const uint32_t DEFAULT_SETTINGS_COALESCE_MS = 100;
+
+/* Called when a request completes, with the response that matched it, or nullptr if no response
+was received after all retries.  The response has already been processed by the PacketProcessor.
+A plain function and a context pointer (rather than a std::function), so queuing one never allocates.*/
+struct ResponseCallback {
+  using Function = void (*)(void *context, const RawPacket *response);
+
+  ResponseCallback() = default;
+  ResponseCallback(std::nullptr_t) {}
+  ResponseCallback(Function function, void *context) : function(function), context(context) {}
+
+  explicit operator bool() const { return function != nullptr; }
+  void operator()(const RawPacket *response) const { function(context, response); }
+  bool operator==(const ResponseCallback &other) const { return function == other.function && context == other.context; }
+
+  Function function = nullptr;
+  void *context = nullptr;
+};
+
+// Most callers a single queued frame can complete (it gains one each time an identical packet is merged into it)
+static const uint8_t MAX_FRAME_CALLBACKS = 4;
+
+// The callbacks waiting on one frame, all completed by the same response
+class ResponseCallbacks {
+  public:
+    // Adds `callback` unless it's already waiting, returning false if there's no room for it
+    bool add(const ResponseCallback &callback);
+    // Calls every callback with `response`
+    void complete(const RawPacket *response) const;
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    uint8_t size() const { return count; }
+
+  private:
+    std::array<ResponseCallback, MAX_FRAME_CALLBACKS> callbacks;
+    uint8_t count = 0;
+};
+
+// Lanes of the PacketQueue.  Lanes are drained in order, so earlier lanes always go first.
+enum class QueueLane : uint8_t {
+  thermostat,  // Packets forwarded on behalf of the thermostat, which times out if kept waiting
+  control,     // Set requests, connection requests, and anything else we generate other than polls
+  poll,        // Get requests we generate to poll the equipment
+};
+static const uint8_t QUEUE_LANE_COUNT = 3;
+
+// A packet waiting in the PacketQueue, stored as its raw frame bytes
+struct QueuedFrame {
+  uint8_t bytes[PACKET_MAX_SIZE];
+  uint8_t length;
+  ControllerAssociation controllerAssociation;
+  bool responseExpected;
+  uint32_t notBeforeMillis;  // The frame is held in the queue until this time
+  ResponseCallbacks callbacks;
+
+  uint8_t getPacketType() const { return bytes[PACKET_HEADER_INDEX_PACKET_TYPE]; }
+  RawPacket rawPacket() const { return RawPacket(bytes, length, SourceBridge::none, controllerAssociation); }
+};
+
+/* A fixed-capacity queue of frames waiting to be sent, with a ring buffer for each QueueLane so it
+never allocates.  Get requests identical to one already waiting in the same lane are merged into it
+rather than queued twice.  Bridges that need to arbitrate between lanes themselves can use the per-lane
+front() and pop().
+
+Settings set requests we generate are held for a short coalescing window, during which any further
+settings changes are merged into the waiting packet instead of being sent separately.  Nothing else is
+sent while a settings change is held, so updates requested afterwards still reflect the change.*/
+class PacketQueue {
+  public:
+    /* Adds a packet to its lane.  Returns false if that lane is full, or if the packet was merged into a frame
+    that has no room for another callback.*/
+    bool push(const Packet &packet, const ResponseCallback &callback);
+
+    // Returns the next frame to send, or nullptr if the queue is empty or the next frame is being held
+    QueuedFrame *front();
+    // Removes the frame returned by front()
+    void pop();
+    // Returns the next frame in `lane`, or nullptr if the lane is empty or its next frame is being held
+    QueuedFrame *front(QueueLane lane);
+    // Removes the frame returned by front(lane)
+    void pop(QueueLane lane);
+
+    bool empty() const;
+    size_t size() const;
+    size_t size(QueueLane lane) const { return lanes[static_cast<uint8_t>(lane)].count; }
+
+    // How long settings set requests are held for coalescing (0 to send them immediately)
+    void set_settings_coalesce_window(uint32_t window_ms) { settingsCoalesceMs = window_ms; }
+
+  private:
+    struct Lane {
+      std::array<QueuedFrame, MAX_QUEUE_SIZE> frames;
+      uint8_t head = 0;
+      uint8_t count = 0;
+
+      QueuedFrame &at(uint8_t index) { return frames[(head + index) % MAX_QUEUE_SIZE]; }
+    };
+
+    static QueueLane laneFor(const Packet &packet);
+    QueuedFrame *findDuplicate(Lane &lane, const Packet &packet);
+    QueuedFrame *findSettingsRequest(Lane &lane);
+    static bool isSettingsRequest(const RawPacket &raw);
+    static bool mergeCallback(QueuedFrame &frame, const ResponseCallback &callback);
+
+    std::array<Lane, QUEUE_LANE_COUNT> lanes;
+    uint32_t settingsCoalesceMs = DEFAULT_SETTINGS_COALESCE_MS;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
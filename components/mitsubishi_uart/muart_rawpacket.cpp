@@ -19,7 +19,16 @@ RawPacket::RawPacket(PacketType packet_type, uint8_t payload_size, SourceBridge
 RawPacket::RawPacket(const uint8_t packet_bytes[], const uint8_t packet_length, SourceBridge source_bridge, ControllerAssociation controller_association)
     : length{(uint8_t) packet_length}, checksumIndex{(uint8_t)(packet_length - 1)},
     sourceBridge{source_bridge}, controllerAssociation{controller_association} {
+  // Too short for a header and checksum, or too long for the buffer: keep it empty, with an invalid checksum
+  if (packet_length < PACKET_HEADER_SIZE + 1 || packet_length > PACKET_MAX_SIZE) {
+    ESP_LOGW(PTAG, "Ignoring packet with invalid length %i.", packet_length);
+    length = 0;
+    checksumIndex = 0;
+    return;
+  }
+
   memcpy(packetBytes, packet_bytes, packet_length);
+  checksumValid = packetBytes[checksumIndex] == calculateChecksum();
 
   if (!this->isChecksumValid()) {
     // For now, just log this as information (we can decide if we want to process it elsewhere)
@@ -43,11 +52,10 @@ uint8_t RawPacket::calculateChecksum() const {
 
 RawPacket &RawPacket::updateChecksum() {
   packetBytes[checksumIndex] = calculateChecksum();
+  checksumValid = true;
   return *this;
 }
 
-bool RawPacket::isChecksumValid() const { return packetBytes[checksumIndex] == calculateChecksum(); }
-
 // Sets a payload byte and automatically updates the packet checksum
 RawPacket &RawPacket::setPayloadByte(const uint8_t payload_byte_index, const uint8_t value) {
   packetBytes[PACKET_HEADER_SIZE + payload_byte_index] = value;
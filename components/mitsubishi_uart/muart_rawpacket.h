@@ -8,13 +8,14 @@
 namespace esphome {
 namespace mitsubishi_uart {
 
-static const char *PTAG = "mitsubishi_uart.packets";
+static const char *const PTAG = "mitsubishi_uart.packets";
 
 const uint8_t BYTE_CONTROL = 0xfc;
 const uint8_t PACKET_MAX_SIZE = 22;  // Used to intialize empty packet
 const uint8_t PACKET_HEADER_SIZE = 5;
 const uint8_t PACKET_HEADER_INDEX_PACKET_TYPE = 1;
 const uint8_t PACKET_HEADER_INDEX_PAYLOAD_LENGTH = 4;
+const uint8_t PACKET_TYPE_RESPONSE_FLAG = 0x20;  // Response packet types are their request type with this bit set
 
 
 // TODO: Figure out something here so we don't have to static_cast<uint8_t> as much
@@ -83,7 +84,8 @@ class RawPacket {
   uint8_t getLength() const { return length; };
   const uint8_t *getBytes() const { return packetBytes; };  // Primarily for sending packets
 
-  bool isChecksumValid() const;
+  // Checksum validity is determined once when a packet is read, and kept valid when building packets
+  bool isChecksumValid() const { return checksumValid; };
 
   // Returns the packet type byte
   uint8_t getPacketType() const { return packetBytes[PACKET_HEADER_INDEX_PACKET_TYPE]; };
@@ -92,6 +94,8 @@ class RawPacket {
 
   SourceBridge getSourceBridge() const { return sourceBridge; };
   ControllerAssociation getControllerAssociation() const { return controllerAssociation; };
+  // Used to associate a received response with the controller that sent the matching request
+  void setControllerAssociation(ControllerAssociation controller_association) { controllerAssociation = controller_association; };
 
   RawPacket &setPayloadByte(const uint8_t payload_byte_index, const uint8_t value);
   uint8_t getPayloadByte(const uint8_t payload_byte_index) const {
@@ -104,6 +108,7 @@ class RawPacket {
   uint8_t packetBytes[PACKET_MAX_SIZE]{};
   uint8_t length;
   uint8_t checksumIndex;
+  bool checksumValid = false;
 
   SourceBridge sourceBridge;
   ControllerAssociation controllerAssociation;
@@ -0,0 +1,71 @@
+#include "muart_remotetemp.h"
+#include <cmath>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+void RemoteTemperatureFeed::report(const float temperature) {
+  if (std::isnan(temperature)) return;
+
+  average = hasReading ? smoothing * average + (1 - smoothing) * temperature : temperature;
+  hasReading = true;
+  // Same rounding as MUARTUtils::DegCToTempScaleA, so equal values here mean an identical packet
+  quantized = std::round(average * 2) / 2.0f;
+}
+
+bool RemoteTemperatureFeed::due(const uint32_t now) const {
+  if (!hasReading) return false;
+  if (!hasSent) return true;
+  if (quantized != sentQuantized) return now - lastSentMillis >= minIntervalMs;
+  return now - lastSentMillis >= keepaliveMs;
+}
+
+void RemoteTemperatureFeed::markSent(const uint32_t now) {
+  hasSent = true;
+  sentQuantized = quantized;
+  lastSentMillis = now;
+}
+
+void RemoteTemperatureFeed::reset() {
+  hasReading = false;
+  hasSent = false;
+}
+
+bool TemperatureSourceTable::record(const std::string &source, const float temperature, const uint32_t now) {
+  if (std::isnan(temperature)) return true;
+
+  TemperatureSourceReading *reading = nullptr;
+  for (uint8_t i = 0; i < count; i++) {
+    if (readings[i].source == source) reading = &readings[i];
+  }
+  if (reading == nullptr) {
+    if (count >= MAX_TEMPERATURE_SOURCES) return false;
+    reading = &readings[count++];
+    reading->source = source;
+  }
+
+  reading->temperature = temperature;
+  reading->receivedMillis = now;
+  return true;
+}
+
+const TemperatureSourceReading *TemperatureSourceTable::fresh(const std::string &source, const uint32_t now,
+                                                              const uint32_t max_age_ms) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (readings[i].source == source) return now - readings[i].receivedMillis <= max_age_ms ? &readings[i] : nullptr;
+  }
+  return nullptr;
+}
+
+const TemperatureSourceReading *TemperatureSourceTable::freshest(const uint32_t now, const uint32_t max_age_ms) const {
+  const TemperatureSourceReading *best = nullptr;
+  for (uint8_t i = 0; i < count; i++) {
+    const uint32_t age = now - readings[i].receivedMillis;
+    if (age > max_age_ms) continue;
+    if (best == nullptr || age < now - best->receivedMillis) best = &readings[i];
+  }
+  return best;
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
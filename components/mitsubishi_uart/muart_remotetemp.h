@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Defaults for RemoteTemperatureFeed
+static const uint32_t DEFAULT_REMOTE_TEMPERATURE_MIN_INTERVAL_MS = 10000;
+// The heatpump reverts to its internal sensor after ~10min without a remote temperature
+static const uint32_t DEFAULT_REMOTE_TEMPERATURE_KEEPALIVE_MS = 120000;
+
+/* Decides when a remote temperature needs sending to the heatpump.  Readings are (optionally) smoothed with an
+exponential moving average, then quantized to the 0.5°C the packet can carry; a new value is only sent when that
+changes, and at most once per `minIntervalMs`.  The last value is re-sent every `keepaliveMs` so the heatpump
+doesn't time it out while the temperature is steady.  A changed value held back by the minimum interval is sent
+as soon as the interval is up.*/
+class RemoteTemperatureFeed {
+  public:
+    void set_min_interval(uint32_t interval_ms) { minIntervalMs = interval_ms; };
+    void set_keepalive(uint32_t keepalive_ms) { keepaliveMs = keepalive_ms; };
+    // Weight (0-1) given to the previous average for each new reading (0 to use readings as-is)
+    void set_smoothing(float smoothing) { this->smoothing = smoothing; };
+
+    // Takes a reading from the selected source
+    void report(float temperature);
+    // Whether a packet should be sent now; if so, temperature() is the value to send
+    bool due(uint32_t now) const;
+    // Counts temperature() as sent at `now`; call once the packet has actually been queued
+    void markSent(uint32_t now);
+    // The quantized value to send
+    float temperature() const { return quantized; };
+
+    // Forgets everything (e.g. the source changed), so the next reading is sent straight away
+    void reset();
+
+  private:
+    uint32_t minIntervalMs = DEFAULT_REMOTE_TEMPERATURE_MIN_INTERVAL_MS;
+    uint32_t keepaliveMs = DEFAULT_REMOTE_TEMPERATURE_KEEPALIVE_MS;
+    float smoothing = 0;
+
+    bool hasReading = false;
+    float average = 0;
+    float quantized = 0;
+
+    bool hasSent = false;
+    float sentQuantized = 0;
+    uint32_t lastSentMillis = 0;
+};
+
+// Most temperature sources whose readings are kept (readings from any others are ignored)
+static const uint8_t MAX_TEMPERATURE_SOURCES = 8;
+
+// The last reading from one temperature source
+struct TemperatureSourceReading {
+  std::string source;
+  float temperature = 0;
+  uint32_t receivedMillis = 0;
+};
+
+/* The last reading from every temperature source, so switching sources can use a reading straight away instead of
+waiting for the new source to report, and a stale source can be replaced by whichever other source is freshest.*/
+class TemperatureSourceTable {
+  public:
+    // Stores a reading, returning false if the table is full
+    bool record(const std::string &source, float temperature, uint32_t now);
+    // The reading from `source`, if it's no older than `max_age_ms`
+    const TemperatureSourceReading *fresh(const std::string &source, uint32_t now, uint32_t max_age_ms) const;
+    // The most recent reading no older than `max_age_ms`, if there is one
+    const TemperatureSourceReading *freshest(uint32_t now, uint32_t max_age_ms) const;
+
+  private:
+    std::array<TemperatureSourceReading, MAX_TEMPERATURE_SOURCES> readings;
+    uint8_t count = 0;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
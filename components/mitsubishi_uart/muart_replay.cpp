@@ -0,0 +1,116 @@
+#include "muart_replay.h"
+#include "muart_packet_dispatch.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+bool CaptureReplayer::replayCapture(const uint8_t *data, const size_t length) {
+  if (length < sizeof(CAPTURE_MAGIC) || memcmp(data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+    ESP_LOGW(REPLAY_TAG, "Not a capture (bad magic or version).");
+    return false;
+  }
+
+  size_t pos = sizeof(CAPTURE_MAGIC);
+  CapturedFrame frame;
+  while (pos < length) {
+    const size_t consumed = PacketCapture::deserialize(data + pos, length - pos, frame);
+    if (consumed == 0) {
+      ESP_LOGW(REPLAY_TAG, "Truncated or invalid record at offset %u.", (unsigned) pos);
+      return false;
+    }
+    replayFrame(frame);
+    pos += consumed;
+  }
+  return true;
+}
+
+static int8_t hex_value(const char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool CaptureReplayer::replayLogLine(const char *line) {
+  const char *hex = strstr(line, CAPTURE_LOG_PREFIX);
+  if (hex == nullptr) return false;
+  hex += strlen(CAPTURE_LOG_PREFIX);
+
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE];
+  size_t length = 0;
+  while (length < sizeof(record)) {
+    const int8_t high = hex_value(hex[length * 2]);
+    if (high < 0) break;
+    const int8_t low = hex_value(hex[length * 2 + 1]);
+    if (low < 0) break;
+    record[length++] = (high << 4) | low;
+  }
+
+  CapturedFrame frame;
+  if (PacketCapture::deserialize(record, length, frame) == 0) return false;
+  replayFrame(frame);
+  return true;
+}
+
+void CaptureReplayer::replayBytes(const uint8_t *data, const size_t length, const SourceBridge source,
+                                  const uint32_t timestamp_millis) {
+  FrameParser &parser = parsers[static_cast<uint8_t>(source)];
+  for (size_t i = 0; i < length; i++) {
+    if (!parser.parse(data[i], timestamp_millis)) continue;
+
+    CapturedFrame frame;
+    frame.timestampMillis = timestamp_millis;
+    frame.source = source;
+    frame.flags = 0;
+    frame.length = parser.length();
+    memcpy(frame.bytes, parser.frame(), frame.length);
+    if (beforeFrameCallback) beforeFrameCallback(frame);
+
+    processFrame(parser.frame(), parser.length(), source);
+    frame.flags = packet.isChecksumValid() ? CAPTURE_FLAG_CHECKSUM_VALID : 0;
+    if (frameCallback) frameCallback(frame);
+  }
+}
+
+void CaptureReplayer::replayFrame(const CapturedFrame &frame) {
+  if (beforeFrameCallback) beforeFrameCallback(frame);
+  if (!frame.isSent() && static_cast<uint8_t>(frame.source) < 3) {
+    // Run the bytes through the same framing the bridge used, in case the capture was cut mid-frame
+    FrameParser &parser = parsers[static_cast<uint8_t>(frame.source)];
+    for (uint8_t i = 0; i < frame.length; i++) {
+      if (parser.parse(frame.bytes[i], frame.timestampMillis)) processFrame(parser.frame(), parser.length(), frame.source);
+    }
+  }
+  if (frameCallback) frameCallback(frame);
+}
+
+void CaptureReplayer::processFrame(const uint8_t *bytes, const uint8_t length, const SourceBridge source) {
+  packet = RawPacket(bytes, length, source,
+                     source == SourceBridge::thermostat ? ControllerAssociation::thermostat : ControllerAssociation::muart);
+  if (!packet.isChecksumValid()) {
+    invalid++;
+    return;
+  }
+  replayed++;
+  dispatchRawPacket(processor, packet);
+}
+
+void PacketRecorder::record(const PacketHandler handler, const Packet &packet) {
+  counts[static_cast<uint8_t>(handler)]++;
+  lastPackets[static_cast<uint8_t>(handler)] = packet.rawPacket();
+}
+
+uint32_t PacketRecorder::total() const {
+  uint32_t sum = 0;
+  for (const uint32_t count : counts) sum += count;
+  return sum;
+}
+
+const RawPacket *PacketRecorder::last(const PacketHandler handler) const {
+  return count(handler) > 0 ? &lastPackets[static_cast<uint8_t>(handler)] : nullptr;
+}
+
+void PacketRecorder::clear() { counts.fill(0); }
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "muart_bridge.h"
+#include "muart_capture.h"
+#include <array>
+#include <functional>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+static const char *const REPLAY_TAG = "mitsubishi_uart.replay";
+
+/* Feeds recorded traffic (see muart_capture.h) back through the bridges' framing and the packet dispatch
+table into a PacketProcessor, as if it had just been received.  Nothing is sent or waited for, so this runs
+as fast as the processor can handle packets, which makes it suitable for regression testing packet handlers
+against long captures.
+
+Only received frames are replayed; frames the bridges sent are reported to the frame callback but otherwise
+skipped.  Responses to requests the thermostat made are replayed as if MUART had made them, since which
+controller a response belongs to isn't recorded.
+
+MitsubishiUART's handlers queue packets to send and forward packets between the bridges, so replay into one in
+replay mode (MitsubishiUART::set_replay_mode) to see the state and entities a capture produces, calling its loop()
+from the frame callback so changes are committed as they would have been, or into a processor without side effects,
+such as PacketRecorder, to check dispatch alone.*/
+class CaptureReplayer {
+  public:
+    // Called after each frame is replayed, e.g. to sample the processor's state and build a timeline
+    using FrameCallback = std::function<void(const CapturedFrame &frame)>;
+
+    explicit CaptureReplayer(PacketProcessor &packet_processor) : processor{packet_processor} {}
+
+    void set_frame_callback(FrameCallback callback) { frameCallback = std::move(callback); }
+    // Called before each frame is replayed, e.g. to move a simulated clock to the frame's timestamp
+    void set_before_frame_callback(FrameCallback callback) { beforeFrameCallback = std::move(callback); }
+
+    // Replays a capture file (CAPTURE_MAGIC followed by records).  Returns false if `data` isn't a complete capture.
+    bool replayCapture(const uint8_t *data, size_t length);
+    // Replays a record exported over the log.  Anything before CAPTURE_LOG_PREFIX is ignored; returns false if there's no record.
+    bool replayLogLine(const char *line);
+    // Replays raw bytes received by `source` (e.g. from a serial sniffer) without capture records around them
+    void replayBytes(const uint8_t *data, size_t length, SourceBridge source, uint32_t timestamp_millis = 0);
+
+    // Frames passed to the PacketProcessor so far
+    uint32_t framesReplayed() const { return replayed; }
+    // Received frames skipped because their checksum was invalid
+    uint32_t invalidFrames() const { return invalid; }
+
+  private:
+    void replayFrame(const CapturedFrame &frame);
+    void processFrame(const uint8_t *bytes, uint8_t length, SourceBridge source);
+
+    PacketProcessor &processor;
+    FrameCallback frameCallback;
+    FrameCallback beforeFrameCallback;
+    // One parser per SourceBridge, so frames from each side can't corrupt the other's partial frames
+    FrameParser parsers[3];
+    RawPacket packet;
+    uint32_t replayed = 0;
+    uint32_t invalid = 0;
+};
+
+// The PacketProcessor handler a packet reached, as recorded by PacketRecorder
+enum class PacketHandler : uint8_t {
+  generic,
+  connect_request,
+  connect_response,
+  extended_connect_request,
+  extended_connect_response,
+  get_request,
+  settings_get_response,
+  current_temp_get_response,
+  status_get_response,
+  standby_get_response,
+  error_state_get_response,
+  remote_temperature_set_request,
+  set_response,
+};
+static const uint8_t PACKET_HANDLER_COUNT = 13;
+
+/* A PacketProcessor with no side effects, for replaying captures: it counts the packets reaching each handler and
+keeps the most recent one, so the dispatch of a capture can be checked without anything being sent.*/
+class PacketRecorder : public PacketProcessor {
+  public:
+    void processPacket(const Packet &packet) override { record(PacketHandler::generic, packet); };
+    void processPacket(const ConnectRequestPacket &packet) override { record(PacketHandler::connect_request, packet); };
+    void processPacket(const ConnectResponsePacket &packet) override { record(PacketHandler::connect_response, packet); };
+    void processPacket(const ExtendedConnectRequestPacket &packet) override {
+      record(PacketHandler::extended_connect_request, packet);
+    };
+    void processPacket(const ExtendedConnectResponsePacket &packet) override {
+      record(PacketHandler::extended_connect_response, packet);
+    };
+    void processPacket(const GetRequestPacket &packet) override { record(PacketHandler::get_request, packet); };
+    void processPacket(const SettingsGetResponsePacket &packet) override {
+      record(PacketHandler::settings_get_response, packet);
+    };
+    void processPacket(const CurrentTempGetResponsePacket &packet) override {
+      record(PacketHandler::current_temp_get_response, packet);
+    };
+    void processPacket(const StatusGetResponsePacket &packet) override { record(PacketHandler::status_get_response, packet); };
+    void processPacket(const StandbyGetResponsePacket &packet) override {
+      record(PacketHandler::standby_get_response, packet);
+    };
+    void processPacket(const ErrorStateGetResponsePacket &packet) override {
+      record(PacketHandler::error_state_get_response, packet);
+    };
+    void processPacket(const RemoteTemperatureSetRequestPacket &packet) override {
+      record(PacketHandler::remote_temperature_set_request, packet);
+    };
+    void processPacket(const SetResponsePacket &packet) override { record(PacketHandler::set_response, packet); };
+
+    // Number of packets that reached `handler`
+    uint32_t count(PacketHandler handler) const { return counts[static_cast<uint8_t>(handler)]; }
+    // Number of packets recorded, across every handler
+    uint32_t total() const;
+    // The most recent packet that reached `handler`, or nullptr if none has
+    const RawPacket *last(PacketHandler handler) const;
+    void clear();
+
+  private:
+    void record(PacketHandler handler, const Packet &packet);
+
+    std::array<uint32_t, PACKET_HANDLER_COUNT> counts{};
+    std::array<RawPacket, PACKET_HANDLER_COUNT> lastPackets;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
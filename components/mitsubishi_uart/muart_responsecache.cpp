@@ -0,0 +1,45 @@
+#include "muart_responsecache.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+void ResponseCache::store(const RawPacket &response) {
+  if (ttlMs == 0) return;
+
+  // Reuse this command's entry, otherwise an empty one, otherwise the oldest
+  CachedResponse *entry = nullptr;
+  for (CachedResponse &candidate : entries) {
+    if (candidate.length > 0 && candidate.command == response.getCommand()) {
+      entry = &candidate;
+      break;
+    }
+    if (entry == nullptr || candidate.length == 0
+        || (entry->length > 0 && (int32_t) (candidate.receivedMillis - entry->receivedMillis) < 0)) {
+      entry = &candidate;
+    }
+  }
+
+  memcpy(entry->bytes, response.getBytes(), response.getLength());
+  entry->length = response.getLength();
+  entry->command = response.getCommand();
+  entry->controllerAssociation = response.getControllerAssociation();
+  entry->receivedMillis = millis();
+}
+
+const CachedResponse *ResponseCache::fresh(const uint8_t command) const {
+  for (const CachedResponse &entry : entries) {
+    if (entry.length > 0 && entry.command == command) {
+      return millis() - entry.receivedMillis < ttlMs ? &entry : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+void ResponseCache::invalidate() {
+  for (CachedResponse &entry : entries) {
+    entry.length = 0;
+  }
+}
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
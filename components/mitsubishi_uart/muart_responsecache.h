@@ -0,0 +1,45 @@
+#pragma once
+
+#include "muart_rawpacket.h"
+#include <array>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Default time a cached get response can be used in place of asking the heatpump again
+static const uint32_t DEFAULT_RESPONSE_CACHE_TTL_MS = 5000;
+// Number of different GetCommands that can be cached at once (the oldest entry is replaced when full)
+static const uint8_t RESPONSE_CACHE_SIZE = 8;
+
+// The latest heatpump response to a GetCommand
+struct CachedResponse {
+  uint8_t bytes[PACKET_MAX_SIZE];
+  uint8_t length = 0;
+  uint8_t command;
+  ControllerAssociation controllerAssociation;  // Which controller's request fetched this response
+  uint32_t receivedMillis;
+
+  RawPacket rawPacket() const { return RawPacket(bytes, length, SourceBridge::heatpump, controllerAssociation); }
+};
+
+/* Latest get responses from the heatpump, keyed by GetCommand, so a value fetched for one controller can be
+served to the other without asking the heatpump again while it's still fresh.*/
+class ResponseCache {
+  public:
+    // Remembers a get response from the heatpump, replacing any earlier response to the same command
+    void store(const RawPacket &response);
+    // Returns the response to `command` if one was received within the TTL, otherwise nullptr
+    const CachedResponse *fresh(uint8_t command) const;
+    // Forgets all responses (e.g. after a set request changed the heatpump's state)
+    void invalidate();
+
+    // How long a response can be served from the cache (0 disables the cache)
+    void set_ttl(uint32_t ttl_ms) { ttlMs = ttl_ms; }
+
+  private:
+    std::array<CachedResponse, RESPONSE_CACHE_SIZE> entries;
+    uint32_t ttlMs = DEFAULT_RESPONSE_CACHE_TTL_MS;
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
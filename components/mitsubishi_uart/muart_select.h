@@ -27,7 +27,8 @@ class TemperatureSourceSelect : public MUARTSelect {
 class VanePositionSelect : public MUARTSelect {
   protected:
     void control(const std::string &value) {
-      if (parent_->select_vane_position(value)) {
+      const optional<size_t> index = index_of(value);
+      if (index.has_value() && parent_->select_vane_position(index.value())) {
         publish_state(value);
       }
     }
@@ -36,7 +37,8 @@ class VanePositionSelect : public MUARTSelect {
 class HorizontalVanePositionSelect : public MUARTSelect {
   protected:
     void control(const std::string &value) {
-      if (parent_->select_horizontal_vane_position(value)) {
+      const optional<size_t> index = index_of(value);
+      if (index.has_value() && parent_->select_horizontal_vane_position(index.value())) {
         publish_state(value);
       }
     }
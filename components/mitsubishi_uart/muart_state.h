@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace mitsubishi_uart {
+
+// Groups of HeatpumpState fields, one per packet they're read from
+static const uint8_t STATE_SETTINGS = 1 << 0;      // SettingsGetResponsePacket
+static const uint8_t STATE_CURRENT_TEMP = 1 << 1;  // CurrentTempGetResponsePacket
+static const uint8_t STATE_STATUS = 1 << 2;        // StatusGetResponsePacket
+static const uint8_t STATE_STANDBY = 1 << 3;       // StandbyGetResponsePacket
+static const uint8_t STATE_ERROR = 1 << 4;         // ErrorStateGetResponsePacket
+static const uint8_t STATE_THERMOSTAT = 1 << 5;    // RemoteTemperatureSetRequestPacket from the thermostat
+
+// How long changes wait for the rest of a poll cycle's responses before they're committed anyway
+static const uint32_t MAX_STATE_COMMIT_WAIT_MS = 1000;
+// Groups persisted so they can be shown straight away after a reboot (see MUARTLastState)
+static const uint8_t STATE_PERSISTED = STATE_SETTINGS | STATE_CURRENT_TEMP;
+// Changes to persisted groups are written at most this often, to spare the flash
+static const uint32_t STATE_SAVE_INTERVAL_MS = 60000;
+
+/* The heat pump's state, exactly as reported in packets.  Packet handlers only write to a working copy,
+which is committed as a whole once a poll cycle's responses have all arrived; entities are then derived
+from the committed snapshot, so they never mix values from different cycles or depend on the order in
+which responses arrived.  Plain data, so snapshots are cheap to copy and compare.*/
+struct HeatpumpState {
+  uint32_t generation = 0;  // Number of times the state has been committed
+  uint8_t received = 0;     // STATE_* groups that have been reported at least once
+
+  // Settings
+  bool power = false;
+  uint8_t mode = 0;  // SettingsSetRequestPacket::MODE_BYTE
+  uint8_t fan = 0;
+  uint8_t vane = 0;            // SettingsSetRequestPacket::VANE_BYTE
+  uint8_t horizontalVane = 0;  // SettingsSetRequestPacket::HORIZONTAL_VANE_BYTE
+  float targetTemperature = NAN;
+
+  // Current temperature
+  float currentTemperature = NAN;
+
+  // Status
+  bool operating = false;
+  uint8_t compressorFrequency = 0;
+
+  // Standby
+  bool serviceFilter = false;
+  bool defrost = false;
+  bool hotAdjust = false;
+  bool standby = false;
+  uint8_t actualFanSpeed = 0;
+
+  // Error state
+  bool errorPresent = false;
+  uint8_t errorShortCode = 0;
+  uint16_t errorCode = 0;
+
+  // Thermostat
+  float thermostatTemperature = NAN;
+
+  // Sets `field` to `value`, returning true if that changed it
+  template<typename T, typename V> static bool update(T &field, const V value) {
+    if (field == static_cast<T>(value)) return false;
+    field = value;
+    return true;
+  }
+};
+
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -11,7 +11,7 @@ class MUARTUtils {
     auto resultLength = (dataLength / wordSize) + (dataLength % wordSize != 0);
     auto result = std::string();
 
-    for (int i = 0; i < resultLength; i++) {
+    for (size_t i = 0; i < resultLength; i++) {
       auto bits = BitSlice(data, i * wordSize, ((i + 1) * wordSize) - 1);
       if (bits <= 0x1F) bits += 0x40;
       result += (char)bits;
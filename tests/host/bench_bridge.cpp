@@ -0,0 +1,194 @@
+// Benchmarks the heat pump side of the component against the simulated heat pump (heatpump_emulator.h):
+//   muart_bench [simulated seconds, default 600]
+// Each scenario reports frames per simulated and per wall-clock second, the wall-clock time taken by each loop()
+// call (percentiles), and the send queue depth and request round trips seen by the bridge's metrics.
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "esphome/core/hal.h"
+#include "fake_uart.h"
+#include "heatpump_emulator.h"
+#include "muart_mappings.h"
+#include "muart_select.h"
+#include "mitsubishi_uart.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+using esphome::mitsubishi_uart::host::HeatpumpEmulator;
+
+// Accepts every packet without doing anything with it, so only the bridge is measured
+class NullProcessor : public PacketProcessor {};
+
+// Wall-clock durations of loop() calls, in nanoseconds
+class LoopTimes {
+ public:
+  template<typename F> void time(F &&call) {
+    const auto start = std::chrono::steady_clock::now();
+    call();
+    const auto end = std::chrono::steady_clock::now();
+    samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+  }
+
+  uint64_t total() const {
+    uint64_t sum = 0;
+    for (uint64_t sample : samples) sum += sample;
+    return sum;
+  }
+
+  void print() {
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [this](double p) {
+      return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))] / 1000.0;
+    };
+    std::printf("  loop() latency (us): p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f  (%zu loops)\n",
+                percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999), samples.back() / 1000.0,
+                samples.size());
+  }
+
+ private:
+  std::vector<uint64_t> samples;
+};
+
+static void printThroughput(const HeatpumpEmulator &emulator, uint32_t simulated_ms, uint64_t wall_ns) {
+  const uint32_t frames = emulator.requestCount() + emulator.responseCount();
+  std::printf("  frames: %" PRIu32 "  (%.1f/s simulated, %.0f/s wall clock in loop() and the emulator)\n", frames,
+              frames * 1000.0 / simulated_ms, wall_ns > 0 ? frames * 1e9 / wall_ns : 0.0);
+}
+
+static void printBridgeMetrics(float max_queue_depth, float average_queue_depth, float round_trip_p50,
+                               float round_trip_p95) {
+  std::printf("  queue depth: max %.0f  avg %.2f    round trip (ms): p50 %.0f  p95 %.0f\n", max_queue_depth,
+              average_queue_depth, round_trip_p50, round_trip_p95);
+}
+
+/* The bridge alone, polling five values every `poll_interval_ms` (once the previous poll has been answered) and
+sending a settings change every 5 seconds.  With `baud_rate` 0 the line and the unit are instant, so this measures
+how many frames the bridge itself can handle.*/
+static void benchBridge(const char *name, uint32_t baud_rate, uint32_t poll_interval_ms, uint32_t simulated_ms) {
+  static const GetCommand POLL[] = {GetCommand::settings, GetCommand::current_temp, GetCommand::status,
+                                    GetCommand::standby, GetCommand::error_info};
+  ::esphome::host::set_millis(0);
+  FakeUART uart;
+  uart.set_baud_rate(baud_rate);
+  HeatpumpEmulator emulator(uart);
+  if (baud_rate == 0) emulator.set_response_delay(0);
+  NullProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  LoopTimes times;
+  uint64_t wallNs = 0;
+  uint32_t lastPoll = 0;
+  bool first = true;
+
+  for (uint32_t now = 0; now < simulated_ms; now++) {
+    ::esphome::host::set_millis(now);
+    if (bridge.requestsSettled() && (first || now - lastPoll >= poll_interval_ms)) {
+      for (GetCommand command : POLL) bridge.sendPacket(GetRequestPacket::forCommand(command));
+      lastPoll = now;
+      first = false;
+    }
+    if (now % 5000 == 0) {
+      auto settings = SettingsSetRequestPacket::create();
+      settings.setTargetTemperature(20.0f + (now / 5000) % 8);
+      bridge.sendPacket(settings);
+    }
+
+    times.time([&] { bridge.loop(); });
+    const auto start = std::chrono::steady_clock::now();
+    emulator.step();
+    wallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::printf("%s\n", name);
+  printThroughput(emulator, simulated_ms, wallNs + times.total());
+  times.print();
+  printBridgeMetrics(bridge.metric(BridgeMetric::max_queue_depth), bridge.metric(BridgeMetric::average_queue_depth),
+                     bridge.metric(BridgeMetric::round_trip_p50), bridge.metric(BridgeMetric::round_trip_p95));
+}
+
+/* The whole component at 2400 baud, with a 1 second update interval and a climate change every 30 seconds, looped
+every millisecond.  Queue depth and round trips are the values the metric sensors published.*/
+static void benchComponent(uint32_t simulated_ms) {
+  ::esphome::host::set_millis(0);
+  FakeUART uart;
+  MitsubishiUART component(&uart);
+  HeatpumpEmulator emulator(uart);
+  TemperatureSourceSelect temperatureSource;
+  VanePositionSelect vanePosition;
+  HorizontalVanePositionSelect horizontalVanePosition;
+  temperatureSource.traits.set_options({"Internal"});
+  vanePosition.traits.set_options(mappingNames(VANE_MAPPINGS));
+  horizontalVanePosition.traits.set_options(mappingNames(HORIZONTAL_VANE_MAPPINGS));
+  temperatureSource.set_parent(&component);
+  vanePosition.set_parent(&component);
+  horizontalVanePosition.set_parent(&component);
+  component.set_temperature_source_select(&temperatureSource);
+  component.set_vane_position_select(&vanePosition);
+  component.set_horizontal_vane_position_select(&horizontalVanePosition);
+  component.set_update_interval(1000);
+
+  sensor::Sensor maxQueueDepth, averageQueueDepth, roundTripP50, roundTripP95;
+  component.set_heatpump_metric_sensor(BridgeMetric::max_queue_depth, &maxQueueDepth);
+  component.set_heatpump_metric_sensor(BridgeMetric::average_queue_depth, &averageQueueDepth);
+  component.set_heatpump_metric_sensor(BridgeMetric::round_trip_p50, &roundTripP50);
+  component.set_heatpump_metric_sensor(BridgeMetric::round_trip_p95, &roundTripP95);
+  // Metrics are published per window; keep the worst maximum and the mean of everything else
+  float worstQueueDepth = 0;
+  float sums[3] = {0, 0, 0};
+  int counts[3] = {0, 0, 0};
+  auto accumulate = [&](int index, float value) {
+    if (std::isnan(value)) return;
+    sums[index] += value;
+    counts[index]++;
+  };
+  maxQueueDepth.add_on_state_callback([&](float value) {
+    if (!std::isnan(value)) worstQueueDepth = std::max(worstQueueDepth, value);
+  });
+  averageQueueDepth.add_on_state_callback([&](float value) { accumulate(0, value); });
+  roundTripP50.add_on_state_callback([&](float value) { accumulate(1, value); });
+  roundTripP95.add_on_state_callback([&](float value) { accumulate(2, value); });
+
+  component.setup();
+  LoopTimes times;
+  uint64_t otherNs = 0;
+  for (uint32_t now = 1; now < simulated_ms; now++) {
+    ::esphome::host::set_millis(now);
+    if (now % 30000 == 0) {
+      component.make_call()
+          .set_mode(now % 60000 == 0 ? climate::CLIMATE_MODE_HEAT : climate::CLIMATE_MODE_COOL)
+          .set_target_temperature(20.0f + (now / 30000) % 8)
+          .perform();
+    }
+
+    times.time([&] { component.loop(); });
+    const auto start = std::chrono::steady_clock::now();
+    emulator.step();
+    if (now % component.get_update_interval() == 0) component.update();
+    otherNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::printf("component, 2400 baud, 1s update interval\n");
+  printThroughput(emulator, simulated_ms, otherNs + times.total());
+  times.print();
+  auto mean = [&](int index) { return counts[index] > 0 ? sums[index] / counts[index] : NAN; };
+  printBridgeMetrics(worstQueueDepth, mean(0), mean(1), mean(2));
+}
+
+int main(int argc, char **argv) {
+  const uint32_t simulatedSeconds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 600;
+  if (simulatedSeconds == 0) {
+    std::fprintf(stderr, "usage: %s [simulated seconds]\n", argv[0]);
+    return 2;
+  }
+  const uint32_t simulatedMs = simulatedSeconds * 1000;
+
+  std::printf("%" PRIu32 " simulated seconds per scenario\n\n", simulatedSeconds);
+  benchBridge("bridge, 2400 baud, polling every 500ms", 2400, 500, simulatedMs);
+  benchBridge("bridge, instant line, polling continuously", 0, 0, simulatedMs);
+  benchComponent(simulatedMs);
+  return 0;
+}
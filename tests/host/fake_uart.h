@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "esphome/components/uart/uart.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+namespace host {
+
+// An in-memory UART: tests push bytes "from the heatpump" into `rx` and inspect what the bridge wrote in `tx`
+class FakeUART : public uart::UARTComponent {
+ public:
+  void write_array(const uint8_t *data, size_t len) override { tx.insert(tx.end(), data, data + len); }
+
+  bool read_array(uint8_t *data, size_t len) override {
+    if (rx.size() < len) return false;
+    for (size_t i = 0; i < len; i++) {
+      data[i] = rx.front();
+      rx.pop_front();
+    }
+    return true;
+  }
+
+  bool peek_byte(uint8_t *data) override {
+    if (rx.empty()) return false;
+    *data = rx.front();
+    return true;
+  }
+
+  int available() override { return static_cast<int>(rx.size()); }
+  void flush() override {}
+
+  void push(const uint8_t *data, size_t len) { rx.insert(rx.end(), data, data + len); }
+  void push(const std::vector<uint8_t> &data) { rx.insert(rx.end(), data.begin(), data.end()); }
+
+  std::deque<uint8_t> rx;
+  std::vector<uint8_t> tx;
+};
+
+}  // namespace host
+}  // namespace mitsubishi_uart
+}  // namespace esphome
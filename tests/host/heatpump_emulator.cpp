@@ -0,0 +1,211 @@
+#include "heatpump_emulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include "esphome/core/hal.h"
+#include "muart_utils.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+namespace host {
+
+// Payload layout of the frames the emulator reads and writes (see the packet classes in muart_packet.h)
+static const uint8_t GET_RESPONSE_PAYLOAD_SIZE = 16;
+static const uint8_t SETTINGS_FLAGS_POWER = 0x01;
+static const uint8_t SETTINGS_FLAGS_MODE = 0x02;
+static const uint8_t SETTINGS_FLAGS_TARGET_TEMPERATURE = 0x04;
+static const uint8_t SETTINGS_FLAGS_FAN = 0x08;
+static const uint8_t SETTINGS_FLAGS_VANE = 0x10;
+static const uint8_t SETTINGS_FLAGS2_HORIZONTAL_VANE = 0x01;
+static const uint8_t SET_RESULT_REJECTED = 0x01;
+
+// Bits on the line per byte: start, 8 data, even parity, stop
+static const uint32_t UART_BITS_PER_BYTE = 11;
+
+bool HeatpumpEmulator::State::operating() const {
+  if (!power) return false;
+  switch (mode) {
+    case SettingsSetRequestPacket::MODE_BYTE_HEAT:
+      return roomTemperature() < targetTemperature;
+    case SettingsSetRequestPacket::MODE_BYTE_COOL:
+    case SettingsSetRequestPacket::MODE_BYTE_DRY:
+      return roomTemperature() > targetTemperature;
+    case SettingsSetRequestPacket::MODE_BYTE_AUTO:
+      return std::fabs(roomTemperature() - targetTemperature) >= 1.0f;
+    default:
+      return false;
+  }
+}
+
+uint32_t HeatpumpEmulator::requestCount(PacketType type) const {
+  return requestsByType[static_cast<uint8_t>(type)];
+}
+
+uint64_t HeatpumpEmulator::byteMicros() const {
+  uint32_t baud = uart.get_baud_rate();
+  if (baud == 0) return 0;
+  return (UART_BITS_PER_BYTE * 1000000ULL + baud - 1) / baud;
+}
+
+void HeatpumpEmulator::step() {
+  const uint64_t nowMicros = static_cast<uint64_t>(millis()) * 1000;
+
+  // Whatever the component wrote since the last step starts transmitting now, behind anything still on the line
+  for (uint8_t byte : uart.tx) {
+    inboundLineFreeMicros = std::max(inboundLineFreeMicros, nowMicros) + byteMicros();
+    inbound.push_back({byte, inboundLineFreeMicros});
+  }
+  uart.tx.clear();
+
+  while (!inbound.empty() && inbound.front().arrivalMicros <= nowMicros) {
+    const TimedByte arrived = inbound.front();
+    inbound.pop_front();
+    if (!parser.parse(arrived.value, static_cast<uint32_t>(arrived.arrivalMicros / 1000))) continue;
+
+    RawPacket request(parser.frame(), parser.length());
+    if (!request.isChecksumValid()) {
+      corruptFrames++;
+      continue;
+    }
+    requestReceived(request, arrived.arrivalMicros);
+  }
+
+  while (!outbound.empty() && outbound.front().arrivalMicros <= nowMicros) {
+    uart.rx.push_back(outbound.front().value);
+    outbound.pop_front();
+  }
+}
+
+void HeatpumpEmulator::send(const RawPacket &response, uint64_t ready_micros) {
+  for (uint8_t i = 0; i < response.getLength(); i++) {
+    outboundLineFreeMicros = std::max(outboundLineFreeMicros, ready_micros) + byteMicros();
+    outbound.push_back({response.getBytes()[i], outboundLineFreeMicros});
+  }
+  responses++;
+}
+
+void HeatpumpEmulator::requestReceived(const RawPacket &request, uint64_t arrival_micros) {
+  requests++;
+  requestsByType[request.getPacketType()]++;
+  if (muted) return;
+
+  const uint64_t readyMicros = arrival_micros + static_cast<uint64_t>(responseDelayMs) * 1000;
+  switch (static_cast<PacketType>(request.getPacketType())) {
+    case PacketType::connect_request: {
+      RawPacket response(PacketType::connect_response, 1);
+      send(response, readyMicros);
+      break;
+    }
+    case PacketType::extended_connect_request:
+      send(extendedConnectResponse(), readyMicros);
+      break;
+    case PacketType::get_request:
+      send(getResponse(static_cast<GetCommand>(request.getCommand())), readyMicros);
+      break;
+    case PacketType::set_request: {
+      RawPacket response(PacketType::set_response, GET_RESPONSE_PAYLOAD_SIZE);
+      switch (static_cast<SetCommand>(request.getCommand())) {
+        case SetCommand::settings:
+          if (rejectingSettings) {
+            response.setPayloadByte(0, SET_RESULT_REJECTED);
+          } else {
+            settingsSet(request);
+          }
+          break;
+        case SetCommand::remote_temperature:
+          remoteTemperatureSet(request);
+          break;
+        case SetCommand::thermostat_hello:
+          return;  // Real units don't answer this
+        default:
+          break;
+      }
+      send(response, readyMicros);
+      break;
+    }
+    default:
+      break;  // Not a request: ignored, as a real unit would
+  }
+}
+
+void HeatpumpEmulator::settingsSet(const RawPacket &request) {
+  const uint8_t flags = request.getPayloadByte(1);
+  const uint8_t flags2 = request.getPayloadByte(2);
+
+  if (flags & SETTINGS_FLAGS_POWER) state.power = request.getPayloadByte(3) != 0;
+  if (flags & SETTINGS_FLAGS_MODE) state.mode = request.getPayloadByte(4);
+  if (flags & SETTINGS_FLAGS_TARGET_TEMPERATURE) {
+    const uint8_t scaleA = request.getPayloadByte(14);
+    state.targetTemperature = scaleA != 0 ? MUARTUtils::TempScaleAToDegC(scaleA)
+                                          : MUARTUtils::LegacyTargetTempToDegC(request.getPayloadByte(5));
+  }
+  if (flags & SETTINGS_FLAGS_FAN) state.fan = request.getPayloadByte(6);
+  if (flags & SETTINGS_FLAGS_VANE) state.vane = request.getPayloadByte(7);
+  if (flags2 & SETTINGS_FLAGS2_HORIZONTAL_VANE) state.horizontalVane = request.getPayloadByte(13);
+}
+
+void HeatpumpEmulator::remoteTemperatureSet(const RawPacket &request) {
+  state.usingRemoteTemperature = request.getPayloadByte(1) & 0x01;
+  if (!state.usingRemoteTemperature) return;
+
+  const uint8_t scaleA = request.getPayloadByte(3);
+  state.remoteTemperature = scaleA != 0 ? MUARTUtils::TempScaleAToDegC(scaleA)
+                                        : MUARTUtils::LegacyRoomTempToDegC(request.getPayloadByte(2));
+}
+
+RawPacket HeatpumpEmulator::extendedConnectResponse() const {
+  RawPacket response(PacketType::extended_connect_response, GET_RESPONSE_PAYLOAD_SIZE);
+  response.setPayloadByte(0, 0xc9);
+  // Vane and vane swing supported, and 5 fan speeds (bits spread over bytes 7 and 8)
+  response.setPayloadByte(7, 0x20 | 0x40 | 0x10);
+  response.setPayloadByte(8, 0x08);
+  // Setpoint ranges: cool/dry 16-31, heat 10-31, auto 16-31
+  response.setPayloadByte(10, MUARTUtils::DegCToTempScaleA(16));
+  response.setPayloadByte(11, MUARTUtils::DegCToTempScaleA(31));
+  response.setPayloadByte(12, MUARTUtils::DegCToTempScaleA(10));
+  response.setPayloadByte(13, MUARTUtils::DegCToTempScaleA(31));
+  response.setPayloadByte(14, MUARTUtils::DegCToTempScaleA(16));
+  response.setPayloadByte(15, MUARTUtils::DegCToTempScaleA(31));
+  return response;
+}
+
+RawPacket HeatpumpEmulator::getResponse(GetCommand command) const {
+  RawPacket response(PacketType::get_response, GET_RESPONSE_PAYLOAD_SIZE);
+  response.setPayloadByte(0, static_cast<uint8_t>(command));
+
+  switch (command) {
+    case GetCommand::settings:
+      response.setPayloadByte(3, state.power ? 0x01 : 0x00);
+      response.setPayloadByte(4, state.mode);
+      response.setPayloadByte(5, MUARTUtils::DegCToLegacyTargetTemp(state.targetTemperature));
+      response.setPayloadByte(6, state.fan);
+      response.setPayloadByte(7, state.vane);
+      response.setPayloadByte(10, state.horizontalVane);
+      response.setPayloadByte(11, MUARTUtils::DegCToTempScaleA(state.targetTemperature));
+      break;
+    case GetCommand::current_temp:
+      response.setPayloadByte(3, MUARTUtils::DegCToLegacyRoomTemp(state.roomTemperature()));
+      response.setPayloadByte(6, MUARTUtils::DegCToTempScaleA(state.roomTemperature()));
+      break;
+    case GetCommand::error_info:
+      response.setPayloadByte(4, state.errorCode >> 8);
+      response.setPayloadByte(5, state.errorCode & 0xff);
+      response.setPayloadByte(6, state.errorShortCode);
+      break;
+    case GetCommand::status:
+      response.setPayloadByte(3, state.operating() ? 40 : 0);
+      response.setPayloadByte(4, state.operating() ? 0x01 : 0x00);
+      break;
+    case GetCommand::standby:
+      // Actual fan speed: 0 when off, otherwise "Low" (or the set speed, when one is set)
+      response.setPayloadByte(4, !state.power ? 0 : (state.fan == SettingsSetRequestPacket::FAN_AUTO ? 3 : state.fan));
+      break;
+    default:
+      break;  // Commands we don't model get an otherwise empty response, like units that don't support them
+  }
+  return response;
+}
+
+}  // namespace host
+}  // namespace mitsubishi_uart
+}  // namespace esphome
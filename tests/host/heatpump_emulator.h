@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include "fake_uart.h"
+#include "muart_bridge.h"
+#include "muart_packet.h"
+
+namespace esphome {
+namespace mitsubishi_uart {
+namespace host {
+
+// Default time a simulated unit takes to start answering a request, once the request has finished arriving
+static const uint32_t DEFAULT_EMULATOR_RESPONSE_DELAY_MS = 20;
+
+/* A simulated heat pump on the far end of a FakeUART.  Bytes the component writes take a character time each
+(11 bits at the UART's baud rate) to arrive, requests are answered `responseDelayMs` after they've arrived, and
+the answer's bytes become readable a character time apart, all on the simulated millis() clock.  A baud rate of 0
+makes the line instant, for measuring processing time rather than bus time.
+
+Answers connect and extended connect requests, get requests (settings, current temp, status, standby and error
+info; anything else gets an empty response, like a real unit), and settings and remote temperature set requests,
+which are applied so later responses reflect them.  Call step() after every loop() of the component.*/
+class HeatpumpEmulator {
+ public:
+  // What the unit reports, in packet terms
+  struct State {
+    bool power = false;
+    uint8_t mode = SettingsSetRequestPacket::MODE_BYTE_COOL;
+    uint8_t fan = SettingsSetRequestPacket::FAN_AUTO;
+    uint8_t vane = SettingsSetRequestPacket::VANE_AUTO;
+    uint8_t horizontalVane = SettingsSetRequestPacket::HV_CENTER;
+    float targetTemperature = 22.0f;
+    float internalTemperature = 21.0f;
+    float remoteTemperature = 0;
+    bool usingRemoteTemperature = false;
+    uint16_t errorCode = 0x8000;  // No error
+    uint8_t errorShortCode = 0;
+
+    // The room temperature the unit is working from
+    float roomTemperature() const { return usingRemoteTemperature ? remoteTemperature : internalTemperature; }
+    // Whether the compressor would be running (heating or cooling towards the target)
+    bool operating() const;
+  };
+
+  explicit HeatpumpEmulator(FakeUART &uart) : uart{uart} {}
+
+  // Moves bytes along the line in both directions and answers any request that has finished arriving
+  void step();
+
+  void set_response_delay(uint32_t delay_ms) { responseDelayMs = delay_ms; }
+  // Stops answering requests (they're still counted), e.g. to test timeouts
+  void set_muted(bool muted) { this->muted = muted; }
+  // Answers settings set requests with an error result and leaves the settings as they were
+  void set_rejecting_settings(bool rejecting) { rejectingSettings = rejecting; }
+
+  State state;
+
+  // Requests received (complete frames with a valid checksum), in total and of one packet type
+  uint32_t requestCount() const { return requests; }
+  uint32_t requestCount(PacketType type) const;
+  uint32_t responseCount() const { return responses; }
+  // Frames that arrived with a bad checksum
+  uint32_t corruptFrameCount() const { return corruptFrames; }
+
+ private:
+  // A byte in flight, and when it reaches the other end of the line
+  struct TimedByte {
+    uint8_t value;
+    uint64_t arrivalMicros;
+  };
+
+  void requestReceived(const RawPacket &request, uint64_t arrival_micros);
+  void settingsSet(const RawPacket &request);
+  void remoteTemperatureSet(const RawPacket &request);
+  RawPacket getResponse(GetCommand command) const;
+  RawPacket extendedConnectResponse() const;
+  void send(const RawPacket &response, uint64_t ready_micros);
+  uint64_t byteMicros() const;
+
+  FakeUART &uart;
+  FrameParser parser;
+  std::deque<TimedByte> inbound;   // From the component, not yet arrived
+  std::deque<TimedByte> outbound;  // To the component, not yet readable
+  uint64_t inboundLineFreeMicros = 0;
+  uint64_t outboundLineFreeMicros = 0;
+
+  uint32_t responseDelayMs = DEFAULT_EMULATOR_RESPONSE_DELAY_MS;
+  bool muted = false;
+  bool rejectingSettings = false;
+
+  uint32_t requests = 0;
+  uint32_t requestsByType[256]{};
+  uint32_t responses = 0;
+  uint32_t corruptFrames = 0;
+};
+
+}  // namespace host
+}  // namespace mitsubishi_uart
+}  // namespace esphome
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal test helpers for the host tests: CHECK records a failure and carries on, finish() reports and sets the exit code
+
+namespace esphome {
+namespace mitsubishi_uart {
+namespace host {
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+inline int finish() {
+  if (failures() > 0) {
+    std::printf("%d check(s) failed\n", failures());
+    return 1;
+  }
+  std::printf("All checks passed\n");
+  return 0;
+}
+
+}  // namespace host
+}  // namespace mitsubishi_uart
+}  // namespace esphome
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+      ::esphome::mitsubishi_uart::host::failures()++; \
+    } \
+  } while (0)
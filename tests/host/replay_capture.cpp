@@ -0,0 +1,207 @@
+// Replays a capture through a MitsubishiUART in replay mode and prints the state it would have published:
+//   muart_replay <capture file, or a log containing exported capture records>
+// The component's loop() and update() run on the simulated clock between frames, as ESPHome would run them, so
+// changes are committed and published when they would have been on the device.  Ends with the frame rate.
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "esphome/core/hal.h"
+#include "fake_uart.h"
+#include "muart_mappings.h"
+#include "muart_replay.h"
+#include "muart_select.h"
+#include "mitsubishi_uart.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+
+// ESPHome's default time between loop() calls
+static const uint32_t LOOP_INTERVAL_MS = 16;
+
+static const char *modeName(climate::ClimateMode mode) {
+  static const char *const NAMES[] = {"off", "heat_cool", "cool", "heat", "fan_only", "dry", "auto"};
+  return mode < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[mode] : "?";
+}
+
+static const char *actionName(climate::ClimateAction action) {
+  static const char *const NAMES[] = {"off", "?", "cooling", "heating", "idle", "drying", "fan"};
+  return action < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[action] : "?";
+}
+
+static const char *fanName(const climate::Climate &climate) {
+  static const char *const NAMES[] = {"on", "off", "auto", "low", "medium", "high", "middle", "focus", "diffuse",
+                                      "quiet"};
+  if (climate.custom_fan_mode.has_value()) return climate.custom_fan_mode.value().c_str();
+  if (!climate.fan_mode.has_value()) return "-";
+  return climate.fan_mode.value() < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[climate.fan_mode.value()] : "?";
+}
+
+static const char *swingName(climate::ClimateSwingMode swing) {
+  static const char *const NAMES[] = {"off", "both", "vertical", "horizontal"};
+  return swing < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[swing] : "?";
+}
+
+// A MitsubishiUART in replay mode with every entity attached, printing whatever it publishes
+class ReplayTimeline {
+ public:
+  ReplayTimeline() : component(&uart) {
+    temperatureSource.traits.set_options({"Internal"});
+    vanePosition.traits.set_options(mappingNames(VANE_MAPPINGS));
+    horizontalVanePosition.traits.set_options(mappingNames(HORIZONTAL_VANE_MAPPINGS));
+    temperatureSource.set_parent(&component);
+    vanePosition.set_parent(&component);
+    horizontalVanePosition.set_parent(&component);
+    component.set_temperature_source_select(&temperatureSource);
+    component.set_vane_position_select(&vanePosition);
+    component.set_horizontal_vane_position_select(&horizontalVanePosition);
+    component.set_compressor_frequency_sensor(&compressorFrequency);
+    component.set_actual_fan_sensor(&actualFan);
+    component.set_error_code_sensor(&errorCode);
+    component.set_service_filter_sensor(&serviceFilter);
+    component.set_defrost_sensor(&defrost);
+    component.set_hot_adjust_sensor(&hotAdjust);
+    component.set_standby_sensor(&standby);
+    component.set_thermostat_temperature_sensor(&thermostatTemperature);
+    component.set_update_interval(1000);
+    component.set_replay_mode(true);
+  }
+
+  // Runs the component up to `timestamp_millis` (starting it at the first frame), ready for a frame from then
+  void runUntil(uint32_t timestamp_millis) {
+    if (!started) {
+      ::esphome::host::set_millis(timestamp_millis);
+      component.setup();
+      nextLoop = timestamp_millis;
+      nextUpdate = timestamp_millis + component.get_update_interval();
+      started = true;
+    }
+    while (nextLoop <= timestamp_millis) {
+      ::esphome::host::set_millis(nextLoop);
+      component.loop();
+      if (nextLoop >= nextUpdate) {
+        component.update();
+        nextUpdate += component.get_update_interval();
+      }
+      printChanges();
+      nextLoop += LOOP_INTERVAL_MS;
+    }
+    ::esphome::host::set_millis(timestamp_millis);
+  }
+
+  // Lets the component commit and publish what the last frame changed
+  void afterFrame() {
+    component.loop();
+    printChanges();
+  }
+
+  FakeUART uart;
+  MitsubishiUART component;
+
+ private:
+  void printChanges() {
+    const double seconds = millis() / 1000.0;
+    if (component.publish_count != lastClimatePublish) {
+      lastClimatePublish = component.publish_count;
+      std::printf("%10.3fs  climate: mode=%s action=%s target=%.1f current=%.1f fan=%s swing=%s\n", seconds,
+                  modeName(component.mode), actionName(component.action), component.target_temperature,
+                  component.current_temperature, fanName(component), swingName(component.swing_mode));
+    }
+    printIfChanged(seconds, "compressor_frequency", compressorFrequency.state, lastCompressorFrequency);
+    printIfChanged(seconds, "thermostat_temperature", thermostatTemperature.state, lastThermostatTemperature);
+    printIfChanged(seconds, "actual_fan", actualFan.state, lastActualFan);
+    printIfChanged(seconds, "error_code", errorCode.state, lastErrorCode);
+    printIfChanged(seconds, "vane_position", vanePosition.state, lastVanePosition);
+    printIfChanged(seconds, "horizontal_vane_position", horizontalVanePosition.state, lastHorizontalVanePosition);
+    printIfChanged(seconds, "service_filter", serviceFilter.state, lastServiceFilter);
+    printIfChanged(seconds, "defrost", defrost.state, lastDefrost);
+    printIfChanged(seconds, "hot_adjust", hotAdjust.state, lastHotAdjust);
+    printIfChanged(seconds, "standby", standby.state, lastStandby);
+  }
+
+  static void printIfChanged(double seconds, const char *name, float value, float &last) {
+    if (value == last || (std::isnan(value) && std::isnan(last))) return;
+    last = value;
+    std::printf("%10.3fs  %s: %.1f\n", seconds, name, value);
+  }
+  static void printIfChanged(double seconds, const char *name, const std::string &value, std::string &last) {
+    if (value == last) return;
+    last = value;
+    std::printf("%10.3fs  %s: %s\n", seconds, name, value.c_str());
+  }
+  static void printIfChanged(double seconds, const char *name, bool value, bool &last) {
+    if (value == last) return;
+    last = value;
+    std::printf("%10.3fs  %s: %s\n", seconds, name, value ? "on" : "off");
+  }
+
+  TemperatureSourceSelect temperatureSource;
+  VanePositionSelect vanePosition;
+  HorizontalVanePositionSelect horizontalVanePosition;
+  sensor::Sensor compressorFrequency, thermostatTemperature;
+  text_sensor::TextSensor actualFan, errorCode;
+  binary_sensor::BinarySensor serviceFilter, defrost, hotAdjust, standby;
+
+  bool started = false;
+  uint32_t nextLoop = 0;
+  uint32_t nextUpdate = 0;
+  uint32_t lastClimatePublish = 0;
+  float lastCompressorFrequency = NAN, lastThermostatTemperature = NAN;
+  std::string lastActualFan, lastErrorCode, lastVanePosition, lastHorizontalVanePosition;
+  bool lastServiceFilter = false, lastDefrost = false, lastHotAdjust = false, lastStandby = false;
+};
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s <capture file or log>\n", argv[0]);
+    return 2;
+  }
+  std::ifstream input(argv[1], std::ios::binary);
+  if (!input) {
+    std::fprintf(stderr, "Can't open %s\n", argv[1]);
+    return 1;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+  ReplayTimeline timeline;
+  CaptureReplayer replayer(timeline.component);
+  replayer.set_before_frame_callback([&](const CapturedFrame &frame) { timeline.runUntil(frame.timestampMillis); });
+  replayer.set_frame_callback([&](const CapturedFrame &frame) { timeline.afterFrame(); });
+
+  const auto start = std::chrono::steady_clock::now();
+  bool valid = true;
+  if (data.size() >= sizeof(CAPTURE_MAGIC) && memcmp(data.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) == 0) {
+    valid = replayer.replayCapture(data.data(), data.size());
+  } else {
+    // A log: replay every line with a capture record in it
+    std::string line;
+    uint32_t records = 0;
+    for (const uint8_t c : data) {
+      if (c != '\n') {
+        line += static_cast<char>(c);
+        continue;
+      }
+      if (replayer.replayLogLine(line.c_str())) records++;
+      line.clear();
+    }
+    if (replayer.replayLogLine(line.c_str())) records++;
+    valid = records > 0;
+  }
+  const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::printf("%" PRIu32 " frames replayed (%" PRIu32 " with bad checksums skipped) in %.3fs: %.0f frames/s\n",
+              replayer.framesReplayed(), replayer.invalidFrames(), wallSeconds,
+              wallSeconds > 0 ? replayer.framesReplayed() / wallSeconds : 0.0);
+  std::printf("%zu bytes sent (should be 0 in replay mode)\n", timeline.uart.tx.size());
+  if (!valid) {
+    std::fprintf(stderr, "%s isn't a complete capture\n", argv[1]);
+    return 1;
+  }
+  return timeline.uart.tx.empty() ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/core/entity_base.h"
+
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor : public EntityBase {
+ public:
+  bool state{false};
+  void publish_state(bool state) { this->state = state; }
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
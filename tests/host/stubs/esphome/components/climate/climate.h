@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <string>
+#include "esphome/core/component.h"
+#include "esphome/core/entity_base.h"
+
+namespace esphome {
+namespace climate {
+
+// Same values as ESPHome's climate_mode.h, which the packet mappings (muart_mappings.h) translate to and from
+enum ClimateMode : uint8_t {
+  CLIMATE_MODE_OFF = 0,
+  CLIMATE_MODE_HEAT_COOL = 1,
+  CLIMATE_MODE_COOL = 2,
+  CLIMATE_MODE_HEAT = 3,
+  CLIMATE_MODE_FAN_ONLY = 4,
+  CLIMATE_MODE_DRY = 5,
+  CLIMATE_MODE_AUTO = 6,
+};
+
+enum ClimateAction : uint8_t {
+  CLIMATE_ACTION_OFF = 0,
+  CLIMATE_ACTION_COOLING = 2,
+  CLIMATE_ACTION_HEATING = 3,
+  CLIMATE_ACTION_IDLE = 4,
+  CLIMATE_ACTION_DRYING = 5,
+  CLIMATE_ACTION_FAN = 6,
+};
+
+enum ClimateFanMode : uint8_t {
+  CLIMATE_FAN_ON = 0,
+  CLIMATE_FAN_OFF = 1,
+  CLIMATE_FAN_AUTO = 2,
+  CLIMATE_FAN_LOW = 3,
+  CLIMATE_FAN_MEDIUM = 4,
+  CLIMATE_FAN_HIGH = 5,
+  CLIMATE_FAN_MIDDLE = 6,
+  CLIMATE_FAN_FOCUS = 7,
+  CLIMATE_FAN_DIFFUSE = 8,
+  CLIMATE_FAN_QUIET = 9,
+};
+
+enum ClimateSwingMode : uint8_t {
+  CLIMATE_SWING_OFF = 0,
+  CLIMATE_SWING_BOTH = 1,
+  CLIMATE_SWING_VERTICAL = 2,
+  CLIMATE_SWING_HORIZONTAL = 3,
+};
+
+class ClimateTraits {
+ public:
+  void set_supports_current_temperature(bool supports) { supports_current_temperature_ = supports; }
+  bool get_supports_current_temperature() const { return supports_current_temperature_; }
+  void set_supports_two_point_target_temperature(bool supports) { supports_two_point_target_temperature_ = supports; }
+  void set_supports_action(bool supports) { supports_action_ = supports; }
+
+  void set_supported_modes(std::set<ClimateMode> modes) { supported_modes_ = std::move(modes); }
+  void add_supported_mode(ClimateMode mode) { supported_modes_.insert(mode); }
+  bool supports_mode(ClimateMode mode) const { return supported_modes_.count(mode); }
+  const std::set<ClimateMode> &get_supported_modes() const { return supported_modes_; }
+
+  void set_supported_fan_modes(std::set<ClimateFanMode> modes) { supported_fan_modes_ = std::move(modes); }
+  void add_supported_fan_mode(ClimateFanMode mode) { supported_fan_modes_.insert(mode); }
+  bool supports_fan_mode(ClimateFanMode mode) const { return supported_fan_modes_.count(mode); }
+  const std::set<ClimateFanMode> &get_supported_fan_modes() const { return supported_fan_modes_; }
+
+  void set_supported_custom_fan_modes(std::set<std::string> modes) { supported_custom_fan_modes_ = std::move(modes); }
+  void add_supported_custom_fan_mode(const std::string &mode) { supported_custom_fan_modes_.insert(mode); }
+  bool supports_custom_fan_mode(const std::string &mode) const { return supported_custom_fan_modes_.count(mode); }
+  const std::set<std::string> &get_supported_custom_fan_modes() const { return supported_custom_fan_modes_; }
+
+  void set_supported_swing_modes(std::set<ClimateSwingMode> modes) { supported_swing_modes_ = std::move(modes); }
+  void add_supported_swing_mode(ClimateSwingMode mode) { supported_swing_modes_.insert(mode); }
+  bool supports_swing_mode(ClimateSwingMode mode) const { return supported_swing_modes_.count(mode); }
+  const std::set<ClimateSwingMode> &get_supported_swing_modes() const { return supported_swing_modes_; }
+
+  void set_visual_min_temperature(float temperature) { visual_min_temperature_ = temperature; }
+  float get_visual_min_temperature() const { return visual_min_temperature_; }
+  void set_visual_max_temperature(float temperature) { visual_max_temperature_ = temperature; }
+  float get_visual_max_temperature() const { return visual_max_temperature_; }
+  void set_visual_temperature_step(float step) { visual_temperature_step_ = step; }
+
+ protected:
+  bool supports_current_temperature_{false};
+  bool supports_two_point_target_temperature_{false};
+  bool supports_action_{false};
+  std::set<ClimateMode> supported_modes_;
+  std::set<ClimateFanMode> supported_fan_modes_;
+  std::set<std::string> supported_custom_fan_modes_;
+  std::set<ClimateSwingMode> supported_swing_modes_;
+  float visual_min_temperature_{10};
+  float visual_max_temperature_{30};
+  float visual_temperature_step_{0.1};
+};
+
+class Climate;
+
+// A requested change, as built by Home Assistant or an automation and handed to Climate::control() by perform()
+class ClimateCall {
+ public:
+  explicit ClimateCall(Climate *parent) : parent_(parent) {}
+
+  ClimateCall &set_mode(ClimateMode mode) { mode_ = mode; return *this; }
+  ClimateCall &set_target_temperature(float target_temperature) { target_temperature_ = target_temperature; return *this; }
+  ClimateCall &set_fan_mode(ClimateFanMode fan_mode) { fan_mode_ = fan_mode; return *this; }
+  ClimateCall &set_fan_mode(const std::string &fan_mode) { custom_fan_mode_ = fan_mode; return *this; }
+  ClimateCall &set_swing_mode(ClimateSwingMode swing_mode) { swing_mode_ = swing_mode; return *this; }
+  void perform();
+
+  const optional<ClimateMode> &get_mode() const { return mode_; }
+  const optional<float> &get_target_temperature() const { return target_temperature_; }
+  const optional<ClimateFanMode> &get_fan_mode() const { return fan_mode_; }
+  const optional<std::string> &get_custom_fan_mode() const { return custom_fan_mode_; }
+  const optional<ClimateSwingMode> &get_swing_mode() const { return swing_mode_; }
+
+ protected:
+  Climate *parent_;
+  optional<ClimateMode> mode_;
+  optional<float> target_temperature_;
+  optional<ClimateFanMode> fan_mode_;
+  optional<std::string> custom_fan_mode_;
+  optional<ClimateSwingMode> swing_mode_;
+};
+
+// publish_state() just counts, so tests can tell whether the component published
+class Climate : public EntityBase {
+ public:
+  ClimateMode mode{CLIMATE_MODE_OFF};
+  ClimateAction action{CLIMATE_ACTION_OFF};
+  float current_temperature{NAN};
+  float target_temperature{NAN};
+  optional<ClimateFanMode> fan_mode;
+  optional<std::string> custom_fan_mode;
+  ClimateSwingMode swing_mode{CLIMATE_SWING_OFF};
+
+  ClimateCall make_call() { return ClimateCall(this); }
+  void publish_state() { publish_count++; }
+  uint32_t publish_count = 0;
+
+ protected:
+  friend ClimateCall;
+
+  virtual ClimateTraits traits() = 0;
+  virtual void control(const ClimateCall &call) = 0;
+
+  bool set_fan_mode_(ClimateFanMode mode) {
+    const bool changed = !fan_mode.has_value() || *fan_mode != mode || custom_fan_mode.has_value();
+    fan_mode = mode;
+    custom_fan_mode.reset();
+    return changed;
+  }
+  bool set_custom_fan_mode_(const std::string &mode) {
+    const bool changed = !custom_fan_mode.has_value() || *custom_fan_mode != mode || fan_mode.has_value();
+    custom_fan_mode = mode;
+    fan_mode.reset();
+    return changed;
+  }
+};
+
+inline void ClimateCall::perform() { parent_->control(*this); }
+
+}  // namespace climate
+}  // namespace esphome
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace esphome {
+namespace logger {
+
+// Messages above `level` aren't printed (ESPHOME_LOG_LEVEL_*; defaults to WARN, or $MUART_HOST_LOG_LEVEL)
+class Logger {
+ public:
+  int level_for(const char *tag) const { return level; }
+  int level;
+};
+
+extern Logger *global_logger;
+
+}  // namespace logger
+}  // namespace esphome
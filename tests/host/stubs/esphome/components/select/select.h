@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "esphome/core/component.h"
+#include "esphome/core/entity_base.h"
+
+namespace esphome {
+namespace select {
+
+class SelectTraits {
+ public:
+  void set_options(std::vector<std::string> options) { options_ = std::move(options); }
+  const std::vector<std::string> &get_options() const { return options_; }
+
+ protected:
+  std::vector<std::string> options_;
+};
+
+class Select : public EntityBase {
+ public:
+  std::string state;
+  SelectTraits traits;
+
+  void publish_state(const std::string &state) { this->state = state; }
+
+  size_t size() const { return traits.get_options().size(); }
+  bool has_index(size_t index) const { return index < size(); }
+  optional<std::string> at(size_t index) const {
+    if (!has_index(index)) return nullopt;
+    return traits.get_options()[index];
+  }
+  optional<size_t> index_of(const std::string &option) const {
+    for (size_t i = 0; i < size(); i++) {
+      if (traits.get_options()[i] == option) return i;
+    }
+    return nullopt;
+  }
+
+  // Stands in for make_call().set_option(value).perform()
+  void select(const std::string &value) { control(value); }
+
+ protected:
+  virtual void control(const std::string &value) = 0;
+};
+
+}  // namespace select
+}  // namespace esphome
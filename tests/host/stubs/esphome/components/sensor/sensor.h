@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "esphome/core/component.h"
+#include "esphome/core/entity_base.h"
+
+namespace esphome {
+namespace sensor {
+
+class Sensor : public EntityBase {
+ public:
+  float state{NAN};
+  float raw_state{NAN};
+
+  void publish_state(float state) {
+    raw_state = state;
+    this->state = state;
+    for (auto &callback : callbacks_) callback(state);
+  }
+  void add_on_state_callback(std::function<void(float)> &&callback) { callbacks_.push_back(std::move(callback)); }
+
+ protected:
+  std::vector<std::function<void(float)>> callbacks_;
+};
+
+}  // namespace sensor
+}  // namespace esphome
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include "esphome/core/component.h"
+#include "esphome/core/entity_base.h"
+
+namespace esphome {
+namespace text_sensor {
+
+class TextSensor : public EntityBase {
+ public:
+  std::string state;
+  std::string raw_state;
+  void publish_state(const std::string &state) {
+    raw_state = state;
+    this->state = state;
+  }
+};
+
+}  // namespace text_sensor
+}  // namespace esphome
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "esphome/core/component.h"
+
+namespace esphome {
+namespace uart {
+
+// The parts of ESPHome's UARTComponent the bridges use; tests provide the byte streams (see tests/host/fake_uart.h)
+class UARTComponent {
+ public:
+  virtual ~UARTComponent() = default;
+
+  virtual void write_array(const uint8_t *data, size_t len) = 0;
+  virtual bool read_array(uint8_t *data, size_t len) = 0;
+  virtual bool peek_byte(uint8_t *data) = 0;
+  virtual int available() = 0;
+  virtual void flush() = 0;
+
+  bool read_byte(uint8_t *data) { return this->read_array(data, 1); }
+  void write_byte(uint8_t data) { this->write_array(&data, 1); }
+
+  void set_baud_rate(uint32_t baud_rate) { baud_rate_ = baud_rate; }
+  uint32_t get_baud_rate() const { return baud_rate_; }
+
+ protected:
+  uint32_t baud_rate_{2400};
+};
+
+}  // namespace uart
+}  // namespace esphome
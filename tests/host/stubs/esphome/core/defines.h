@@ -0,0 +1,3 @@
+#pragma once
+// Host build of the component: logging is always available (see esphome/components/logger/logger.h)
+#define USE_LOGGER
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+
+// Names and object ID hashes, which the component uses to tell its preferences and log messages apart
+class EntityBase {
+ public:
+  virtual ~EntityBase() = default;
+  const std::string &get_name() const { return name_; }
+  void set_name(const std::string &name) { name_ = name; }
+  uint32_t get_object_id_hash() const;
+
+ protected:
+  std::string name_;
+};
+
+}  // namespace esphome
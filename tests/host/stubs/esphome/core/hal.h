@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+
+// millis() runs on a simulated clock that tests move forward; micros() is the real monotonic clock, for timing
+uint32_t millis();
+uint32_t micros();
+
+namespace host {
+void set_millis(uint32_t now_ms);
+void advance_millis(uint32_t delta_ms);
+// Adds `step_us` to micros() on every call, as if the code between calls were that slow (0 for the real clock)
+void set_micros_step(uint32_t step_us);
+}  // namespace host
+
+}  // namespace esphome
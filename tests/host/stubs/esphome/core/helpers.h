@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "esphome/core/optional.h"
+
+namespace esphome {
+
+std::string format_hex_pretty(const uint8_t *data, size_t length);
+uint32_t fnv1_hash(const std::string &str);
+
+using std::to_string;
+
+template<typename T> T clamp(T value, T min, T max) { return value < min ? min : (value > max ? max : value); }
+
+template<class T> class Parented {
+ public:
+  Parented() {}
+  Parented(T *parent) : parent_(parent) {}
+  T *get_parent() const { return parent_; }
+  void set_parent(T *parent) { parent_ = parent; }
+
+ protected:
+  T *parent_{nullptr};
+};
+
+}  // namespace esphome
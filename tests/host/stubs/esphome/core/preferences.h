@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+// Preferences are kept in memory for as long as the process runs, so a test can "reboot" by building a new component
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t> *data) : data_(data) {}
+
+  template<typename T> bool save(const T *src) {
+    if (data_ == nullptr) return false;
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(src);
+    data_->assign(bytes, bytes + sizeof(T));
+    return true;
+  }
+  template<typename T> bool load(T *dest) {
+    if (data_ == nullptr || data_->size() != sizeof(T)) return false;
+    std::copy(data_->begin(), data_->end(), reinterpret_cast<uint8_t *>(dest));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *data_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type) { return ESPPreferenceObject(&stored_[type]); }
+  // Forgets everything saved, as if the flash had been erased
+  void clear() { stored_.clear(); }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> stored_;
+};
+
+extern ESPPreferences *global_preferences;  // NOLINT
+
+}  // namespace esphome
@@ -0,0 +1,85 @@
+// Implementations behind the stubbed ESPHome headers, for building the component's packet/bridge code on a host
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include "esphome/components/logger/logger.h"
+#include "esphome/core/application.h"
+#include "esphome/core/entity_base.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+
+static uint32_t host_millis = 0;
+static uint32_t host_micros_step = 0;
+static uint32_t host_micros_added = 0;
+
+uint32_t millis() { return host_millis; }
+
+uint32_t micros() {
+  host_micros_added += host_micros_step;
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count()) +
+         host_micros_added;
+}
+
+namespace host {
+void set_millis(uint32_t now_ms) { host_millis = now_ms; }
+void advance_millis(uint32_t delta_ms) { host_millis += delta_ms; }
+void set_micros_step(uint32_t step_us) { host_micros_step = step_us; }
+}  // namespace host
+
+int esp_log_printf_(int level, const char *tag, int line, const char *format, ...) {
+  if (logger::global_logger == nullptr || level > logger::global_logger->level_for(tag)) return 0;
+
+  va_list args;
+  va_start(args, format);
+  std::printf("[%u][%s:%d] ", static_cast<unsigned>(host_millis), tag, line);
+  std::vprintf(format, args);
+  std::printf("\n");
+  va_end(args);
+  return 0;
+}
+
+std::string format_hex_pretty(const uint8_t *data, size_t length) {
+  std::string ret;
+  char buffer[4];
+  for (size_t i = 0; i < length; i++) {
+    std::snprintf(buffer, sizeof(buffer), i == 0 ? "%02X" : ".%02X", data[i]);
+    ret += buffer;
+  }
+  return ret;
+}
+
+// Same as ESPHome's, so object ID hashes (and the preference keys built from them) behave the same
+uint32_t fnv1_hash(const std::string &str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= c;
+  }
+  return hash;
+}
+
+uint32_t EntityBase::get_object_id_hash() const { return fnv1_hash(name_); }
+
+Application App;  // NOLINT
+
+static ESPPreferences host_preferences;
+ESPPreferences *global_preferences = &host_preferences;  // NOLINT
+
+namespace logger {
+
+static int initial_level() {
+  const char *level = std::getenv("MUART_HOST_LOG_LEVEL");
+  return level != nullptr ? std::atoi(level) : ESPHOME_LOG_LEVEL_WARN;
+}
+
+static Logger host_logger{initial_level()};
+Logger *global_logger = &host_logger;
+
+}  // namespace logger
+}  // namespace esphome
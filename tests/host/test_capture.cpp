@@ -0,0 +1,77 @@
+// Round-trips frames through the capture export format, and checks malformed records and frames are rejected.
+#include <cstring>
+#include "host_test.h"
+#include "muart_capture.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+
+static CapturedFrame capturedFrame(const RawPacket &raw, uint32_t timestamp) {
+  CapturedFrame frame{};
+  frame.timestampMillis = timestamp;
+  frame.source = SourceBridge::heatpump;
+  frame.flags = CAPTURE_FLAG_CHECKSUM_VALID;
+  frame.length = raw.getLength();
+  memcpy(frame.bytes, raw.getBytes(), raw.getLength());
+  return frame;
+}
+
+static void testRoundTrip() {
+  RawPacket raw(PacketType::get_response, 16);
+  raw.setPayloadByte(0, static_cast<uint8_t>(GetCommand::settings));
+  const CapturedFrame original = capturedFrame(raw, 0x12345678);
+
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE];
+  const uint8_t recordLength = PacketCapture::serialize(original, record);
+  CHECK(recordLength == CAPTURE_RECORD_HEADER_SIZE + raw.getLength());
+
+  CapturedFrame decoded{};
+  CHECK(PacketCapture::deserialize(record, recordLength, decoded) == recordLength);
+  CHECK(decoded.timestampMillis == 0x12345678);
+  CHECK(decoded.source == SourceBridge::heatpump);
+  CHECK(decoded.isChecksumValid());
+  CHECK(decoded.length == raw.getLength());
+  CHECK(memcmp(decoded.bytes, raw.getBytes(), raw.getLength()) == 0);
+  CHECK(decoded.rawPacket().isChecksumValid());
+
+  // A truncated record is incomplete
+  CHECK(PacketCapture::deserialize(record, recordLength - 1, decoded) == 0);
+}
+
+// Frame lengths that can't hold a header and checksum, or don't fit a packet, are refused
+static void testInvalidFrameLengths() {
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE + 1] = {};
+  CapturedFrame decoded{};
+
+  for (uint8_t frameLength = 0; frameLength <= PACKET_HEADER_SIZE; frameLength++) {
+    record[6] = frameLength;
+    CHECK(PacketCapture::deserialize(record, sizeof(record), decoded) == 0);
+  }
+  record[6] = PACKET_MAX_SIZE + 1;
+  CHECK(PacketCapture::deserialize(record, sizeof(record), decoded) == 0);
+}
+
+// RawPacket keeps a frame of an impossible length empty, rather than indexing outside it
+static void testRawPacketLengthGuard() {
+  const uint8_t bytes[PACKET_MAX_SIZE + 1] = {BYTE_CONTROL};
+
+  const RawPacket empty(bytes, 0);
+  CHECK(empty.getLength() == 0);
+  CHECK(!empty.isChecksumValid());
+
+  const RawPacket headerOnly(bytes, PACKET_HEADER_SIZE);
+  CHECK(headerOnly.getLength() == 0);
+  CHECK(!headerOnly.isChecksumValid());
+
+  const RawPacket oversized(bytes, PACKET_MAX_SIZE + 1);
+  CHECK(oversized.getLength() == 0);
+  CHECK(!oversized.isChecksumValid());
+}
+
+int main() {
+  testRoundTrip();
+  testInvalidFrameLengths();
+  testRawPacketLengthGuard();
+
+  return mitsubishi_uart::host::finish();
+}
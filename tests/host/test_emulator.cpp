@@ -0,0 +1,158 @@
+// Runs the bridge and the whole component against the simulated heat pump (heatpump_emulator.h) on the simulated
+// clock: bus timing at 2400 baud, connecting and polling, and settings changes made through the climate entity.
+#include "esphome/core/hal.h"
+#include "fake_uart.h"
+#include "heatpump_emulator.h"
+#include "host_test.h"
+#include "muart_mappings.h"
+#include "muart_select.h"
+#include "mitsubishi_uart.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+using esphome::mitsubishi_uart::host::HeatpumpEmulator;
+
+// Notes when the settings response arrives
+class SettingsProcessor : public PacketProcessor {
+ public:
+  void processPacket(const SettingsGetResponsePacket &packet) override {
+    settings++;
+    receivedAt = millis();
+  }
+
+  int settings = 0;
+  uint32_t receivedAt = 0;
+};
+
+// A component wired up the way the generated code does it, with the emulator on its heat pump UART
+struct Rig {
+  Rig() : component(&uart), emulator(uart) {
+    temperatureSource.traits.set_options({"Internal"});
+    vanePosition.traits.set_options(mappingNames(VANE_MAPPINGS));
+    horizontalVanePosition.traits.set_options(mappingNames(HORIZONTAL_VANE_MAPPINGS));
+    temperatureSource.set_parent(&component);
+    vanePosition.set_parent(&component);
+    horizontalVanePosition.set_parent(&component);
+    component.set_temperature_source_select(&temperatureSource);
+    component.set_vane_position_select(&vanePosition);
+    component.set_horizontal_vane_position_select(&horizontalVanePosition);
+    component.set_update_interval(1000);
+  }
+
+  // Loops every millisecond for `duration_ms`, calling update() every update interval, as ESPHome's scheduler would
+  void run(uint32_t duration_ms) {
+    for (uint32_t elapsed = 0; elapsed < duration_ms; elapsed++) {
+      ::esphome::host::advance_millis(1);
+      component.loop();
+      emulator.step();
+      if (millis() % component.get_update_interval() == 0) component.update();
+    }
+  }
+
+  FakeUART uart;
+  MitsubishiUART component;
+  HeatpumpEmulator emulator;
+  TemperatureSourceSelect temperatureSource;
+  VanePositionSelect vanePosition;
+  HorizontalVanePositionSelect horizontalVanePosition;
+};
+
+// A get request and its response take a character time per byte at 2400 baud, plus the unit's response delay
+static void testBusTiming() {
+  FakeUART uart;
+  HeatpumpEmulator emulator(uart);
+  SettingsProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(1000);
+
+  bridge.sendPacket(GetRequestPacket::getSettingsInstance());
+  for (int ms = 0; ms < 1000 && processor.settings == 0; ms++) {
+    bridge.loop();
+    emulator.step();
+    ::esphome::host::advance_millis(1);
+  }
+
+  CHECK(processor.settings == 1);
+  CHECK(emulator.requestCount(PacketType::get_request) == 1);
+  // (7 byte request + 22 byte response) * 11 bits / 2400 baud ~= 133ms, plus 20ms to answer
+  const uint32_t roundTrip = processor.receivedAt - 1000;
+  CHECK(roundTrip >= 150 && roundTrip <= 160);
+}
+
+// The component connects, polls, and reflects the unit's state
+static void testConnectAndPoll() {
+  ::esphome::host::set_millis(0);
+  Rig rig;
+  rig.emulator.state.power = true;
+  rig.emulator.state.mode = SettingsSetRequestPacket::MODE_BYTE_COOL;
+  rig.emulator.state.targetTemperature = 23.5f;
+  rig.emulator.state.internalTemperature = 25.0f;
+  rig.component.setup();
+  rig.run(10000);
+
+  CHECK(rig.emulator.requestCount(PacketType::connect_request) >= 1);
+  CHECK(rig.emulator.requestCount(PacketType::get_request) >= 5);
+  CHECK(rig.emulator.corruptFrameCount() == 0);
+  CHECK(rig.component.mode == climate::CLIMATE_MODE_COOL);
+  CHECK(rig.component.action == climate::CLIMATE_ACTION_COOLING);
+  CHECK(rig.component.target_temperature == 23.5f);
+  CHECK(rig.component.current_temperature == 25.0f);
+  CHECK(!rig.component.is_state_provisional());
+}
+
+// Changes made through the climate entity and the selects reach the unit, and rejected ones are undone
+static void testSettingsChanges() {
+  ::esphome::host::set_millis(0);
+  Rig rig;
+  rig.component.setup();
+  rig.run(5000);
+  CHECK(rig.component.mode == climate::CLIMATE_MODE_OFF);
+
+  rig.component.make_call().set_mode(climate::CLIMATE_MODE_HEAT).set_target_temperature(24.0f).perform();
+  rig.vanePosition.select("3");
+  rig.run(5000);
+  CHECK(rig.emulator.requestCount(PacketType::set_request) >= 1);
+  CHECK(rig.emulator.state.power);
+  CHECK(rig.emulator.state.mode == SettingsSetRequestPacket::MODE_BYTE_HEAT);
+  CHECK(rig.emulator.state.targetTemperature == 24.0f);
+  CHECK(rig.emulator.state.vane == SettingsSetRequestPacket::VANE_3);
+  CHECK(rig.component.mode == climate::CLIMATE_MODE_HEAT);
+  CHECK(rig.component.target_temperature == 24.0f);
+  CHECK(rig.vanePosition.state == "3");
+
+  rig.emulator.set_rejecting_settings(true);
+  rig.component.make_call().set_target_temperature(26.0f).perform();
+  rig.run(5000);
+  CHECK(rig.emulator.state.targetTemperature == 24.0f);
+  CHECK(rig.component.target_temperature == 24.0f);
+}
+
+// When every piece of work overruns the loop budget, each loop still makes progress, so the component connects,
+// polls and takes changes, just over more iterations
+static void testExhaustedLoopBudget() {
+  ::esphome::host::set_millis(0);
+  ::esphome::host::set_micros_step(1000);
+  Rig rig;
+  rig.component.set_loop_budget(1000);
+  rig.emulator.state.power = true;
+  rig.emulator.state.targetTemperature = 21.0f;
+  rig.component.setup();
+  rig.run(10000);
+  CHECK(rig.emulator.requestCount(PacketType::get_request) >= 5);
+  CHECK(rig.component.target_temperature == 21.0f);
+
+  rig.component.make_call().set_target_temperature(23.0f).perform();
+  rig.run(5000);
+  CHECK(rig.emulator.state.targetTemperature == 23.0f);
+  CHECK(rig.component.target_temperature == 23.0f);
+  ::esphome::host::set_micros_step(0);
+}
+
+int main() {
+  testBusTiming();
+  testConnectAndPoll();
+  testSettingsChanges();
+  testExhaustedLoopBudget();
+  return mitsubishi_uart::host::finish();
+}
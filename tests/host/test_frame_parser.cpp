@@ -0,0 +1,316 @@
+// Feeds byte streams through a fake UART into the FrameParser and HeatpumpBridge, and exercises the PacketQueue's
+// lanes, merging and settings coalescing.  Runs on the host against the stubbed ESPHome headers (see CMakeLists.txt).
+#include <vector>
+#include "fake_uart.h"
+#include "host_test.h"
+#include "muart_bridge.h"
+#include "muart_packetqueue.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+
+// Counts the packets the bridge hands over, by class
+class RecordingProcessor : public PacketProcessor {
+ public:
+  void processPacket(const Packet &packet) override { other++; }
+  void processPacket(const SettingsGetResponsePacket &packet) override {
+    settings++;
+    lastPower = packet.getPower();
+  }
+  void processPacket(const CurrentTempGetResponsePacket &packet) override { currentTemp++; }
+
+  int settings = 0;
+  int currentTemp = 0;
+  int other = 0;
+  uint8_t lastPower = 0;
+};
+
+// Response callbacks that count calls in the int `context` points to (only calls with a response, for countAnswered)
+static void countCalls(void *context, const RawPacket *response) { ++*static_cast<int *>(context); }
+static void countAnswered(void *context, const RawPacket *response) {
+  if (response != nullptr) ++*static_cast<int *>(context);
+}
+
+static std::vector<uint8_t> frameBytes(const RawPacket &raw) {
+  return std::vector<uint8_t>(raw.getBytes(), raw.getBytes() + raw.getLength());
+}
+
+static RawPacket settingsResponse(uint8_t power) {
+  RawPacket raw(PacketType::get_response, 16);
+  raw.setPayloadByte(0, static_cast<uint8_t>(GetCommand::settings));
+  raw.setPayloadByte(3, power);
+  return raw;
+}
+
+static RawPacket currentTempResponse() {
+  RawPacket raw(PacketType::get_response, 16);
+  raw.setPayloadByte(0, static_cast<uint8_t>(GetCommand::current_temp));
+  return raw;
+}
+
+// A frame trickling in a byte per loop is assembled across calls without blocking
+static void testByteByByte() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  for (uint8_t byte : frameBytes(settingsResponse(1))) {
+    CHECK(processor.settings == 0);
+    uart.push(&byte, 1);
+    bridge.receivePackets();
+  }
+  CHECK(processor.settings == 1);
+  CHECK(processor.lastPower == 1);
+  CHECK(bridge.metric(BridgeMetric::frames_received) == 1);
+  CHECK(bridge.metric(BridgeMetric::resyncs) == 0);
+}
+
+// Packets are handed over as their own class, and classes the processor doesn't handle arrive as a generic Packet
+static void testDispatch() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  RawPacket unknownCommand(PacketType::get_response, 16);
+  unknownCommand.setPayloadByte(0, 0x55);
+  uart.push(frameBytes(currentTempResponse()));
+  uart.push(frameBytes(SetResponsePacket::create().rawPacket()));
+  uart.push(frameBytes(unknownCommand));
+  bridge.receivePackets();
+  CHECK(processor.currentTemp == 1);
+  CHECK(processor.other == 2);
+}
+
+// Several frames arriving at once are all processed
+static void testBackToBackFrames() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  uart.push(frameBytes(settingsResponse(0)));
+  uart.push(frameBytes(currentTempResponse()));
+  uart.push(frameBytes(settingsResponse(1)));
+  bridge.receivePackets();
+
+  CHECK(processor.settings == 2);
+  CHECK(processor.currentTemp == 1);
+  CHECK(processor.lastPower == 1);
+}
+
+// Garbage before a frame is skipped and counted as a single resync
+static void testGarbageResync() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  const uint8_t garbage[] = {0x00, 0x13, 0x37, 0xff};
+  uart.push(garbage, sizeof(garbage));
+  uart.push(frameBytes(settingsResponse(1)));
+  bridge.receivePackets();
+
+  CHECK(processor.settings == 1);
+  CHECK(bridge.metric(BridgeMetric::resyncs) == 1);
+}
+
+// A stray control byte followed by an impossible payload length doesn't swallow the real frame after it
+static void testInvalidPayloadLength() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  const uint8_t bogus[] = {BYTE_CONTROL, 0x62, 0x01, 0x30, 0x40};
+  uart.push(bogus, sizeof(bogus));
+  uart.push(frameBytes(settingsResponse(1)));
+  bridge.receivePackets();
+
+  CHECK(processor.settings == 1);
+  CHECK(bridge.metric(BridgeMetric::resyncs) == 1);
+}
+
+// A bad checksum is counted and the packet isn't processed
+static void testBadChecksum() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  ::esphome::host::set_millis(0);
+
+  std::vector<uint8_t> frame = frameBytes(settingsResponse(1));
+  frame.back() ^= 0xff;
+  uart.push(frame);
+  uart.push(frameBytes(settingsResponse(0)));
+  bridge.receivePackets();
+
+  CHECK(processor.settings == 1);
+  CHECK(processor.lastPower == 0);
+  CHECK(bridge.metric(BridgeMetric::checksum_failures) == 1);
+}
+
+// A truncated frame is dropped once the line has been quiet for the frame gap, instead of eating the next frame
+static void testPartialFrameExpires() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  uart.set_baud_rate(2400);  // Gap of 10 characters is 45ms
+  ::esphome::host::set_millis(0);
+
+  std::vector<uint8_t> truncated = frameBytes(settingsResponse(0));
+  truncated.resize(8);
+  uart.push(truncated);
+  bridge.receivePackets();
+
+  ::esphome::host::advance_millis(20);
+  bridge.receivePackets();  // Still within the gap, so the partial frame is kept
+  CHECK(bridge.metric(BridgeMetric::resyncs) == 0);
+
+  ::esphome::host::advance_millis(40);
+  bridge.receivePackets();
+  CHECK(bridge.metric(BridgeMetric::resyncs) == 1);
+
+  uart.push(frameBytes(settingsResponse(1)));
+  bridge.receivePackets();
+  CHECK(processor.settings == 1);
+  CHECK(processor.lastPower == 1);
+}
+
+// Views don't carry a frame of their own; an OwnedPacket copy keeps its frame after the original is reused
+static_assert(sizeof(SettingsGetResponsePacket) < sizeof(RawPacket), "packet views shouldn't embed a RawPacket");
+
+static void testOwnedPacketCopy() {
+  RawPacket frame = settingsResponse(1);
+  const SettingsGetResponsePacket view(&frame);
+  const OwnedPacket<SettingsGetResponsePacket> kept(view);
+  frame = settingsResponse(0);
+
+  CHECK(view.getPower() == 0);
+  CHECK(kept.getPower() == 1);
+  const OwnedPacket<SettingsGetResponsePacket> copy = kept;
+  CHECK(&copy.rawPacket() != &kept.rawPacket());
+  CHECK(copy.getPower() == 1);
+}
+
+// Our control packets go ahead of polls queued before them, and each lane holds at most MAX_QUEUE_SIZE frames
+static void testQueueLanes() {
+  PacketQueue queue;
+  ::esphome::host::set_millis(0);
+
+  CHECK(queue.push(GetRequestPacket::getSettingsInstance(), nullptr));
+  CHECK(queue.push(ConnectRequestPacket::instance(), nullptr));
+  CHECK(queue.size() == 2);
+  CHECK(queue.size(QueueLane::poll) == 1);
+  CHECK(queue.size(QueueLane::control) == 1);
+
+  CHECK(queue.front()->getPacketType() == static_cast<uint8_t>(PacketType::connect_request));
+  queue.pop();
+  CHECK(queue.front()->getPacketType() == static_cast<uint8_t>(PacketType::get_request));
+  queue.pop();
+  CHECK(queue.empty());
+
+  for (uint8_t i = 0; i < MAX_QUEUE_SIZE; i++) CHECK(queue.push(ConnectRequestPacket::instance(), nullptr));
+  int dropped = 0;
+  CHECK(!queue.push(ConnectRequestPacket::instance(), ResponseCallback(countCalls, &dropped)));
+  CHECK(dropped == 0);  // A rejected packet's callback is left for the caller
+  CHECK(queue.size(QueueLane::control) == MAX_QUEUE_SIZE);
+  // Other lanes have their own capacity
+  CHECK(queue.push(GetRequestPacket::getStatusInstance(), nullptr));
+}
+
+// A get request already waiting absorbs an identical one, and both callers hear about the response
+static void testDuplicateMerge() {
+  PacketQueue queue;
+  ::esphome::host::set_millis(0);
+
+  int first = 0;
+  int second = 0;
+  CHECK(queue.push(GetRequestPacket::getSettingsInstance(), ResponseCallback(countCalls, &first)));
+  CHECK(queue.push(GetRequestPacket::getCurrentTempInstance(), nullptr));
+  CHECK(queue.push(GetRequestPacket::getSettingsInstance(), ResponseCallback(countCalls, &second)));
+  CHECK(queue.push(GetRequestPacket::getSettingsInstance(), ResponseCallback(countCalls, &second)));  // Already waiting
+  CHECK(queue.size() == 2);
+
+  QueuedFrame *frame = queue.front();
+  CHECK(frame->callbacks.size() == 2);
+  frame->callbacks.complete(nullptr);
+  CHECK(first == 1);
+  CHECK(second == 1);
+
+  // Each frame has room for a fixed number of callers; one more is refused rather than allocated for
+  int counts[MAX_FRAME_CALLBACKS + 1] = {};
+  for (uint8_t i = 0; i < MAX_FRAME_CALLBACKS - 2; i++) {
+    CHECK(queue.push(GetRequestPacket::getSettingsInstance(), ResponseCallback(countCalls, &counts[i])));
+  }
+  CHECK(!queue.push(GetRequestPacket::getSettingsInstance(), ResponseCallback(countCalls, &counts[MAX_FRAME_CALLBACKS])));
+  CHECK(queue.size() == 2);
+}
+
+// Settings changes made within the coalescing window go out as one packet, once the window has passed
+static void testSettingsCoalescing() {
+  PacketQueue queue;
+  ::esphome::host::set_millis(1000);
+
+  CHECK(queue.push(SettingsSetRequestPacket::create().setPower(true), nullptr));
+  ::esphome::host::advance_millis(50);
+  CHECK(queue.push(SettingsSetRequestPacket::create().setFan(SettingsSetRequestPacket::FAN_3), nullptr));
+  CHECK(queue.size() == 1);
+  CHECK(queue.front() == nullptr);  // Still held for further changes
+
+  ::esphome::host::advance_millis(DEFAULT_SETTINGS_COALESCE_MS);
+  QueuedFrame *frame = queue.front();
+  CHECK(frame != nullptr);
+  const RawPacket merged = frame->rawPacket();
+  CHECK(merged.isChecksumValid());
+  CHECK(merged.getPayloadByte(3) == 1);  // Power
+  CHECK(merged.getPayloadByte(6) == SettingsSetRequestPacket::FAN_3);
+}
+
+// The bridge sends control before polls, and waits for a response before using a second request slot
+static void testBridgeArbitration() {
+  FakeUART uart;
+  RecordingProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  bridge.set_max_requests_in_flight(1);
+  ::esphome::host::set_millis(0);
+
+  int answered = 0;
+  bridge.sendPacket(GetRequestPacket::getSettingsInstance(), ResponseCallback(countAnswered, &answered));
+  bridge.sendPacket(ConnectRequestPacket::instance());
+  bridge.sendPackets();
+
+  const std::vector<uint8_t> connect = frameBytes(ConnectRequestPacket::instance().rawPacket());
+  CHECK(uart.tx == connect);
+  CHECK(!bridge.requestsSettled());
+
+  uart.tx.clear();
+  uart.push(frameBytes(RawPacket(PacketType::connect_response, 16)));
+  bridge.loop();
+  const std::vector<uint8_t> poll = frameBytes(GetRequestPacket::getSettingsInstance().rawPacket());
+  CHECK(uart.tx == poll);
+
+  uart.push(frameBytes(settingsResponse(1)));
+  bridge.loop();
+  CHECK(answered == 1);
+  CHECK(processor.settings == 1);
+  CHECK(bridge.requestsSettled());
+}
+
+int main() {
+  testByteByByte();
+  testDispatch();
+  testBackToBackFrames();
+  testGarbageResync();
+  testInvalidPayloadLength();
+  testBadChecksum();
+  testPartialFrameExpires();
+  testOwnedPacketCopy();
+  testQueueLanes();
+  testDuplicateMerge();
+  testSettingsCoalescing();
+  testBridgeArbitration();
+
+  return mitsubishi_uart::host::finish();
+}
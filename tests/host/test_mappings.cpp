@@ -0,0 +1,32 @@
+// Checks the vane select options in __init__.py (VANE_POSITIONS, HORIZONTAL_VANE_POSITIONS) against the mapping
+// tables the selects index into, so a change to one without the other is caught.
+#include <string>
+#include <vector>
+#include "host_test.h"
+#include "muart_mappings.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+
+// Copied from __init__.py
+static const std::vector<std::string> VANE_POSITIONS = {"Auto", "1", "2", "3", "4", "5", "Swing"};
+static const std::vector<std::string> HORIZONTAL_VANE_POSITIONS = {"Auto", "<<", "<", "|", ">", ">>", "<>", "Swing"};
+
+// The option at each index is the mapping at that index, and selecting it sends that mapping's byte
+static void testVaneOptions() {
+  CHECK(mappingNames(VANE_MAPPINGS) == VANE_POSITIONS);
+  CHECK(mappingAt(VANE_MAPPINGS, 3)->byte == SettingsSetRequestPacket::VANE_3);
+  CHECK(mappingAt(VANE_MAPPINGS, VANE_POSITIONS.size()) == nullptr);
+}
+
+static void testHorizontalVaneOptions() {
+  CHECK(mappingNames(HORIZONTAL_VANE_MAPPINGS) == HORIZONTAL_VANE_POSITIONS);
+  CHECK(mappingAt(HORIZONTAL_VANE_MAPPINGS, 3)->byte == SettingsSetRequestPacket::HV_CENTER);
+  CHECK(mappingAt(HORIZONTAL_VANE_MAPPINGS, HORIZONTAL_VANE_POSITIONS.size()) == nullptr);
+}
+
+int main() {
+  testVaneOptions();
+  testHorizontalVaneOptions();
+  return mitsubishi_uart::host::finish();
+}
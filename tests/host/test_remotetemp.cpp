@@ -0,0 +1,68 @@
+// Exercises the RemoteTemperatureFeed's send decisions, including a remote temperature the bridge couldn't queue.
+#include "esphome/core/hal.h"
+#include "fake_uart.h"
+#include "host_test.h"
+#include "muart_bridge.h"
+#include "muart_remotetemp.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+
+class NullProcessor : public PacketProcessor {};
+
+// A new value waits out the minimum interval, and a steady one is re-sent every keepalive
+static void testIntervals() {
+  RemoteTemperatureFeed feed;
+  feed.set_min_interval(10000);
+  feed.set_keepalive(60000);
+  CHECK(!feed.due(0));
+
+  feed.report(20.2f);
+  CHECK(feed.due(0));
+  CHECK(feed.temperature() == 20.0f);
+  feed.markSent(0);
+  CHECK(!feed.due(1000));
+
+  feed.report(21.0f);
+  CHECK(!feed.due(9999));
+  CHECK(feed.due(10000));
+  feed.markSent(10000);
+  CHECK(!feed.due(69999));
+  CHECK(feed.due(70000));
+}
+
+// due() doesn't count anything as sent, so a value the queue turned away is still due next time
+static void testQueueFull() {
+  ::esphome::host::set_millis(0);
+  FakeUART uart;
+  NullProcessor processor;
+  HeatpumpBridge bridge(&uart, &processor);
+  RemoteTemperatureFeed feed;
+  feed.report(19.5f);
+
+  // Fill the control lane with sets nobody's looping to send
+  for (uint8_t i = 0; i < MAX_QUEUE_SIZE; i++) {
+    CHECK(bridge.sendPacket(RemoteTemperatureSetRequestPacket::create().setRemoteTemperature(18.0f)));
+  }
+  CHECK(feed.due(0));
+  const bool queued =
+      bridge.sendPacket(RemoteTemperatureSetRequestPacket::create().setRemoteTemperature(feed.temperature()));
+  CHECK(!queued);
+  CHECK(bridge.metric(BridgeMetric::queue_full_drops) == 1);
+  if (queued) feed.markSent(0);
+  CHECK(feed.due(100));
+
+  // Once the queue has drained, it goes
+  for (int ms = 0; ms < 5000; ms++) {
+    ::esphome::host::advance_millis(1);
+    bridge.loop();
+  }
+  CHECK(bridge.sendPacket(RemoteTemperatureSetRequestPacket::create().setRemoteTemperature(feed.temperature())));
+}
+
+int main() {
+  testIntervals();
+  testQueueFull();
+  return mitsubishi_uart::host::finish();
+}
@@ -0,0 +1,187 @@
+// Replays captures through CaptureReplayer into a PacketRecorder, which has no side effects to set up or undo, and
+// into a MitsubishiUART in replay mode, which runs the real handlers without sending anything.
+#include <cstring>
+#include <string>
+#include <vector>
+#include "fake_uart.h"
+#include "host_test.h"
+#include "muart_mappings.h"
+#include "muart_replay.h"
+#include "muart_select.h"
+#include "mitsubishi_uart.h"
+
+using namespace esphome;
+using namespace esphome::mitsubishi_uart;
+using esphome::mitsubishi_uart::host::FakeUART;
+
+static RawPacket getResponse(GetCommand command) {
+  RawPacket raw(PacketType::get_response, 16);
+  raw.setPayloadByte(0, static_cast<uint8_t>(command));
+  return raw;
+}
+
+static void record(PacketCapture &capture, const RawPacket &raw, SourceBridge source, bool sent) {
+  capture.record(raw.getBytes(), raw.getLength(), source, sent, raw.isChecksumValid());
+}
+
+// Builds a capture file from everything in `capture`
+static std::vector<uint8_t> captureFile(const PacketCapture &capture) {
+  std::vector<uint8_t> file(CAPTURE_MAGIC, CAPTURE_MAGIC + sizeof(CAPTURE_MAGIC));
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE];
+  for (uint8_t i = 0; i < capture.size(); i++) {
+    const uint8_t length = PacketCapture::serialize(capture.at(i), record);
+    file.insert(file.end(), record, record + length);
+  }
+  return file;
+}
+
+static void testReplayCapture() {
+  PacketCapture capture;
+  ::esphome::host::set_millis(1000);
+  record(capture, GetRequestPacket::getSettingsInstance().rawPacket(), SourceBridge::heatpump, true);
+  record(capture, getResponse(GetCommand::settings), SourceBridge::heatpump, false);
+  ::esphome::host::advance_millis(100);
+  record(capture, getResponse(GetCommand::current_temp), SourceBridge::heatpump, false);
+  record(capture, RemoteTemperatureSetRequestPacket::create().setRemoteTemperature(21.5).rawPacket(),
+         SourceBridge::thermostat, false);
+
+  RawPacket corrupt = getResponse(GetCommand::status);
+  std::vector<uint8_t> corruptBytes(corrupt.getBytes(), corrupt.getBytes() + corrupt.getLength());
+  corruptBytes.back() ^= 0xff;
+  capture.record(corruptBytes.data(), corruptBytes.size(), SourceBridge::heatpump, false, false);
+
+  PacketRecorder recorder;
+  CaptureReplayer replayer(recorder);
+  uint32_t frames = 0;
+  replayer.set_frame_callback([&frames](const CapturedFrame &frame) { frames++; });
+
+  const std::vector<uint8_t> file = captureFile(capture);
+  CHECK(replayer.replayCapture(file.data(), file.size()));
+
+  CHECK(frames == 5);  // Sent frames are reported, but not processed
+  CHECK(replayer.framesReplayed() == 3);
+  CHECK(replayer.invalidFrames() == 1);
+  CHECK(recorder.total() == 3);
+  CHECK(recorder.count(PacketHandler::get_request) == 0);
+  CHECK(recorder.count(PacketHandler::settings_get_response) == 1);
+  CHECK(recorder.count(PacketHandler::current_temp_get_response) == 1);
+  CHECK(recorder.count(PacketHandler::status_get_response) == 0);
+  CHECK(recorder.count(PacketHandler::remote_temperature_set_request) == 1);
+
+  const RawPacket *remoteTemperature = recorder.last(PacketHandler::remote_temperature_set_request);
+  CHECK(remoteTemperature != nullptr);
+  CHECK(remoteTemperature->getControllerAssociation() == ControllerAssociation::thermostat);
+  RawPacket kept = *remoteTemperature;
+  CHECK(RemoteTemperatureSetRequestPacket(&kept).getRemoteTemperature() == 21.5f);
+
+  // A capture cut off mid-record is reported
+  CHECK(!replayer.replayCapture(file.data(), file.size() - 1));
+  const uint8_t notACapture[] = {'M', 'U', 'C', 'A', 'P', 0x02};
+  CHECK(!replayer.replayCapture(notACapture, sizeof(notACapture)));
+}
+
+// Records exported over the log can be replayed a line at a time, with the log's own prefix still attached
+static void testReplayLogLine() {
+  PacketCapture capture;
+  record(capture, getResponse(GetCommand::standby), SourceBridge::heatpump, false);
+
+  uint8_t record[CAPTURE_RECORD_MAX_SIZE];
+  const uint8_t length = PacketCapture::serialize(capture.at(0), record);
+  std::string line = std::string("[12:00:00][I][mitsubishi_uart.capture:042]: ") + CAPTURE_LOG_PREFIX;
+  char hex[3];
+  for (uint8_t i = 0; i < length; i++) {
+    std::snprintf(hex, sizeof(hex), "%02x", record[i]);
+    line += hex;
+  }
+
+  PacketRecorder recorder;
+  CaptureReplayer replayer(recorder);
+  CHECK(replayer.replayLogLine(line.c_str()));
+  CHECK(recorder.count(PacketHandler::standby_get_response) == 1);
+  CHECK(!replayer.replayLogLine("[I][mitsubishi_uart]: Heatpump connected."));
+}
+
+// Raw sniffer bytes are framed across calls, and each side of the bridge is framed separately
+static void testReplayBytes() {
+  const RawPacket settings = getResponse(GetCommand::settings);
+  const RawPacket request = GetRequestPacket::getStatusInstance().rawPacket();
+
+  PacketRecorder recorder;
+  CaptureReplayer replayer(recorder);
+  replayer.replayBytes(settings.getBytes(), 10, SourceBridge::heatpump, 0);
+  replayer.replayBytes(request.getBytes(), request.getLength(), SourceBridge::thermostat, 1);
+  CHECK(recorder.count(PacketHandler::get_request) == 1);
+  CHECK(recorder.count(PacketHandler::settings_get_response) == 0);
+
+  replayer.replayBytes(settings.getBytes() + 10, settings.getLength() - 10, SourceBridge::heatpump, 2);
+  CHECK(recorder.count(PacketHandler::settings_get_response) == 1);
+  CHECK(replayer.framesReplayed() == 2);
+}
+
+// Replayed into the component, a capture produces the state and entities it would have on the device, and the
+// handlers' own requests and forwarding go nowhere
+static void testReplayIntoComponent() {
+  PacketCapture capture;
+  ::esphome::host::set_millis(1000);
+  record(capture, RawPacket(PacketType::connect_response, 1), SourceBridge::heatpump, false);
+  ::esphome::host::set_millis(2000);
+  RawPacket settings = getResponse(GetCommand::settings);
+  settings.setPayloadByte(3, 0x01);  // Power on
+  settings.setPayloadByte(4, SettingsSetRequestPacket::MODE_BYTE_HEAT);
+  settings.setPayloadByte(11, MUARTUtils::DegCToTempScaleA(22.0f));
+  record(capture, settings, SourceBridge::heatpump, false);
+  RawPacket currentTemp = getResponse(GetCommand::current_temp);
+  currentTemp.setPayloadByte(6, MUARTUtils::DegCToTempScaleA(20.5f));
+  record(capture, currentTemp, SourceBridge::heatpump, false);
+  RawPacket status = getResponse(GetCommand::status);
+  status.setPayloadByte(3, 40);
+  status.setPayloadByte(4, 0x01);  // Operating
+  record(capture, status, SourceBridge::heatpump, false);
+  // The thermostat asking for settings would be forwarded to the heatpump on the device
+  ::esphome::host::set_millis(3000);
+  record(capture, GetRequestPacket::getSettingsInstance().rawPacket(), SourceBridge::thermostat, false);
+
+  FakeUART uart;
+  MitsubishiUART component(&uart);
+  TemperatureSourceSelect temperatureSource;
+  VanePositionSelect vanePosition;
+  HorizontalVanePositionSelect horizontalVanePosition;
+  temperatureSource.traits.set_options({"Internal"});
+  vanePosition.traits.set_options(mappingNames(VANE_MAPPINGS));
+  horizontalVanePosition.traits.set_options(mappingNames(HORIZONTAL_VANE_MAPPINGS));
+  component.set_temperature_source_select(&temperatureSource);
+  component.set_vane_position_select(&vanePosition);
+  component.set_horizontal_vane_position_select(&horizontalVanePosition);
+  component.set_replay_mode(true);
+  ::esphome::host::set_millis(0);
+  component.setup();
+
+  CaptureReplayer replayer(component);
+  replayer.set_before_frame_callback([](const CapturedFrame &frame) {
+    ::esphome::host::set_millis(frame.timestampMillis);
+  });
+  replayer.set_frame_callback([&component](const CapturedFrame &frame) { component.loop(); });
+  const std::vector<uint8_t> file = captureFile(capture);
+  CHECK(replayer.replayCapture(file.data(), file.size()));
+  ::esphome::host::set_millis(4000);
+  component.loop();
+  component.update();
+
+  CHECK(replayer.framesReplayed() == 5);
+  CHECK(uart.tx.empty());
+  CHECK(component.mode == climate::CLIMATE_MODE_HEAT);
+  CHECK(component.action == climate::CLIMATE_ACTION_HEATING);
+  CHECK(component.target_temperature == 22.0f);
+  CHECK(component.current_temperature == 20.5f);
+  CHECK(component.heatpump_state().compressorFrequency == 40);
+  CHECK(component.publish_count > 0);
+}
+
+int main() {
+  testReplayCapture();
+  testReplayLogLine();
+  testReplayBytes();
+  testReplayIntoComponent();
+
+  return mitsubishi_uart::host::finish();
+}